@@ -0,0 +1,404 @@
+/*
+
+Tested using Arduino Nano serial connection at 38400 baud
+with IBM 5110 Type 2 (BASIC-only, no internal tape).  Now defaults to 115200 baud, see below.
+
+NOTE: I had to use "old bootloader" to upload this "Scratch" to the specific Nano that I was using (from the Arduino IDE).
+
+You may be able to increase the Port speed, initially I was using 115200.  But during bulk uploads of 
+buffered text data (i.e. paste into terminal), sometimes issues arose where characters were getting lost.
+I tried also 9600, but decided to "standardize" all timing around 38400.
+(Those losses came from loop() blocking for every key strobe while the 64 byte serial buffer
+filled up.  The keys are now strobed from the Timer1 interrupt and loop() only drains the serial
+input, so 115200 is used again.)
+
+The sketch does not use the Arduino Serial object: the UART receive interrupt stores the input in a
+1KB ring (KBD_RX_RING_SIZE, sixteen times the 64 bytes of Serial), so about a thousand characters of
+a pasted listing can wait there for the IBM 5110 to be typed.  The SRAM comes from the translation
+tables, which are now kept in flash (KBD_PROGMEM, see CODE/common/kbd_progmem.hpp).
+
+The IBM 5100's have several keys not represented in standard ASCII, such as ATTN, Arrow Keys, HOLD, etc.
+To support these in a serial connection, I use a "parse_key" buffer and use the "^" (caret) symbol has a START/STOP
+token to indicate when a parse_key is being indicated.  By convention, I kept each code to 2-characters only.
+
+I later realized some of these special keys could be specified using CTRL codes (ASCII 1 to ASCII 26).
+For example, CTRL-H is typically backspace and CTRL-M is typically enter.
+
+(on the IBM 5110, "CMD" is their version of CTRL)
+
+ASCII                         IBM 5110 Key
+CTRL-A                        UP ARROW
+CTRL-Z                        DOWN ARROW
+CTRL-P                        RIGHT ARROW
+CTRL-O                        LEFT ARROW
+
+CTRL-L                        HOLD
+CTRL-M                        EXECUTE
+
+CTRL-R                        CMD-ATTN               [I tried to make "~" also be CMD-ATTN, but it doesn't seem to work]
+CTRL-T                        CMD-MULTIPLY (STAR)
+CTRL-G                        CMD-MINUS
+CTRL-B                        CMD-PLUS
+
+ESCAPE                        ATTN
+
+On a bluetooth keyboard (with_bluetooth adapter) the keys map directly, the CTRL codes above
+still working:
+
+BLUETOOTH KEYBOARD            IBM 5110 Key
+ARROWS                        ARROWS  (SHIFT-UP / SHIFT-DOWN as on the 5110)
+PAUSE                         HOLD
+ENTER, KEYPAD ENTER           EXECUTE
+CTRL-ESCAPE                   CMD-ATTN
+CTRL-KEYPAD *                 CMD-MULTIPLY (STAR)
+CTRL-MINUS, CTRL-KEYPAD -     CMD-MINUS
+CTRL-EQUAL, CTRL-KEYPAD +     CMD-PLUS
+
+Most other keys (A-Z, 0-9, $&*-+;:.,() should convert as expected)
+
+NOTE: To enter lower case mode on the IBM 5110 -- press HOLD, then SHIFT-DOWN.
+
+Parsed keys offer an alternative way to express CTRL-x commands (such as if your system
+doesn't support CTRL or can't express non-printable characters).  Parsed keys also
+can adjust modes or perform actions (like to DELAY a certain amount of time, to allow
+the IBM 5110 system to finish processing a prior command and avoid "typing too fast").
+
+PARSED KEYS
+-----------
+^LE^                          LEFT ARROW
+^RI^                          RIGHT ARROW
+^UP^                          UP ARROW
+^DO^                          DOWN ARROW
+
+^SU^                          SHIFT-UP ARROW
+^SD^                          SHIFT-DOWN ARROW
+
+^HO^                          HOLD
+^EX^                          EXECUTE
+^AT^                          ATTN
+
+^CA^                          CMD-ATTN
+^CP^                          CMD-PLUS
+^CM^                          CMD-MINUS
+^CS^                          CMD-MULITPLY (STAR)
+
+^Dx^                          DELAY (x = 1 to 9, delay x * 100 milliseconds, e.g. ^D3^ delays 300ms)
+
+^TSxx^                        KEY TIMING, in microseconds (xx = 0 to 65535):  TS data lines setup before the strobe,
+^TWxx^                        TW strobe width (default 10000, below 5000 the IBM 5110 misses keys),
+^THxx^                        TH data lines hold after the strobe (default 10),
+^TGxx^                        TG gap between two keys.  Used to find the fastest timing a given machine accepts
+                              when uploading long listings, e.g. ^TW6000^^TG500^.  Back to the defaults at power up.
+
+^E0^                          TURN OFF INVOKING EXECUTE KEY (used when scripting text files that contain CRLF at end of line)
+^E1^                          TURN ON INVOKING EXECUTE KEY
+
+^U0^                          TURN OFF UTF-8 DECODING (input bytes above 127 are ignored)
+^U1^                          TURN ON UTF-8 DECODING (default)
+
+^FN^                          NO FLOW CONTROL (default, back to it at power up)
+^FX^                          XON/XOFF FLOW CONTROL: XOFF is sent when the 1KB receive ring is 3/4 full, XON once it is
+                              down to 1/4, so the host can paste at full speed and wait for the keys to be typed.
+                              Start a long listing with ^FX^, and turn XON/XOFF on in the terminal.
+^FH^                          RTS/CTS FLOW CONTROL: ESP32 only, ignored by the Nano (no RTS/CTS on its USB serial chip)
+
+COMPOSED CHARACTERS
+-------------------
+Some characters have no key of their own on the IBM 5110, they are typed as a short sequence of keys instead:
+
+!                             ' (SHIFT-K), LEFT ARROW, then . (period)
+[ ]                           ( )
+/ ÷ ⌹                         not typed (the scan code of KEYPAD DIVIDE is still to be read from the MIM)
+
+APL
+---
+Input bytes above 127 are decoded as UTF-8, so APL glyphs (and ¨ ¯ × ≠ ≤ ≥ ∧ ∨) can be pasted from a modern editor.
+Each glyph is sent as its SHIFT key (e.g. ⍴ is SHIFT-R), and composite glyphs such as ⍋ ⍕ ⍱ are typed as overstrikes
+(key, LEFT ARROW, key).  See apl_keys in CODE/common/kbd_profiles.cpp for the full list.
+
+BUILDING
+--------
+The translation itself is shared with the ESP32 firmwares and lives in CODE/common.  Copy the
+files of CODE/common (kbd_*.hpp, kbd_*.cpp) next to this sketch so the Arduino IDE compiles them with it.
+
+*/
+
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
+
+#include "kbd_emitter.hpp"
+#include "kbd_translator.hpp"
+
+// These are the expected sequence between the Arduino digital outputs and the green KEYBOARD header on the IBM 5110.
+// A 330ohm resistor is placed inline between these pinouts and the IBM 5110 keyboard connector.
+//   IBM Kbd Connector                Arduino
+//   KBD_P --------\/\/330ohm\/\/\---- D02
+//   KBD_7 --------\/\/330ohm\/\/\---- D03
+//   KBD_6 --------\/\/330ohm\/\/\---- D04
+//   KBD_5 --------\/\/330ohm\/\/\---- D05
+//   KBD_4 --------\/\/330ohm\/\/\---- D06
+//   KBD_3 --------\/\/330ohm\/\/\---- D07
+//   KBD_2 --------\/\/330ohm\/\/\---- D08
+//   KBD_1 --------\/\/330ohm\/\/\---- D09
+//   KBD_0 --------\/\/330ohm\/\/\---- D10
+//   KBD_STROBE----\/\/330ohm\/\/\---- D11
+
+#define PIN_KBD_P       2
+
+#define PIN_KBD_7       3   // KBD_7
+#define PIN_KBD_6       4   // KBD_6
+#define PIN_KBD_5       5   // KBD_5
+#define PIN_KBD_4       6   // KBD_4
+#define PIN_KBD_3       7   // KBD_3
+#define PIN_KBD_2       8   // KBD_2
+#define PIN_KBD_1       9   // KBD_1
+#define PIN_KBD_0       10  // KBD_0
+
+#define PIN_KBD_STROBE  11
+
+// Pin of each KbdLine, in the order of the KbdLine enumeration.
+static const uint8_t kbd_pins[(uint8_t) KbdLine::COUNT] = {
+  PIN_KBD_0, PIN_KBD_1, PIN_KBD_2, PIN_KBD_3, PIN_KBD_4, PIN_KBD_5, PIN_KBD_6, PIN_KBD_7,
+  PIN_KBD_P,
+  PIN_KBD_STROBE
+};
+
+// Bit of an Arduino pin in the DDRD (D0 to D7, high byte) or DDRB (D8 to D13, low byte) register
+constexpr uint16_t nano_pin_bit(uint8_t pin) { return (pin < 8) ? (uint16_t) ((1 << pin) << 8) : (uint16_t) (1 << (pin - 8)); }
+
+static constexpr uint16_t kbd_pin_bits[(uint8_t) KbdLine::COUNT] = {
+  nano_pin_bit(PIN_KBD_0), nano_pin_bit(PIN_KBD_1), nano_pin_bit(PIN_KBD_2), nano_pin_bit(PIN_KBD_3),
+  nano_pin_bit(PIN_KBD_4), nano_pin_bit(PIN_KBD_5), nano_pin_bit(PIN_KBD_6), nano_pin_bit(PIN_KBD_7),
+  nano_pin_bit(PIN_KBD_P),
+  nano_pin_bit(PIN_KBD_STROBE)
+};
+
+// DDRD / DDRB bits to set for each scan code, in flash (512 bytes)
+static const KbdPinMasks<uint16_t> kbd_key_masks KBD_PROGMEM = kbd_pin_masks(kbd_pin_bits);
+
+static const uint16_t KBD_DATA_LINES_MASK = kbd_pin_mask((uint16_t) (kbd_line_bit(KbdLine::KBD_STROBE) - 1), kbd_pin_bits);
+static const uint16_t KBD_STROBE_MASK     = nano_pin_bit(PIN_KBD_STROBE);
+
+static_assert(PIN_KBD_STROBE >= 8, "set_strobe() expects the STROBE on port B (D8 to D13)");
+
+class NanoKbdHal : public KbdHal
+{
+  public:
+    // A pin is pulled down by setting its DDR bit (OUTPUT, its PORT bit being LOW): one write
+    // per port for a whole key, instead of a pinMode() per line.
+    void set_data_lines(KbdKey key)
+    {
+      const uint16_t mask = kbd_read(&kbd_key_masks.masks[kbd_key_code(key)]);
+      DDRD = (DDRD & ~(KBD_DATA_LINES_MASK >> 8))   | (mask >> 8);
+      DDRB = (DDRB & ~(KBD_DATA_LINES_MASK & 0xFF)) | (mask & 0xFF);
+    }
+    void release_data_lines()
+    {
+      DDRD &= ~(KBD_DATA_LINES_MASK >> 8);
+      DDRB &= ~(KBD_DATA_LINES_MASK & 0xFF);
+    }
+    void set_strobe(bool pulled_low)
+    {
+      if (pulled_low) DDRB |= KBD_STROBE_MASK; else DDRB &= ~KBD_STROBE_MASK;
+    }
+
+    uint32_t now_us() { return micros(); }  // 4us resolution on a 16MHz Nano
+    void wait_until_us(uint32_t deadline_us) { while ((int32_t) (deadline_us - micros()) > 0) { } }
+};
+
+static NanoKbdHal    kbd_hal;
+static KbdEmitter    kbd_emitter(kbd_hal);
+static KbdTranslator kbd_translator;
+
+// ----- Timer1: runs the emitter steps when they are due -----
+//
+// Timer1 counts freely at 2MHz (prescaler 8), and its compare A interrupt is armed for the
+// next step of the emitter.  A step further away than a timer wrap (a ^Dx^ delay) just takes
+// a few interrupts.  The interrupt is off while the emitter is idle.
+
+#define KBD_TIMER_TICKS_PER_US  2
+#define KBD_TIMER_MIN_TICKS     16       // 8us, more than it takes to arm the timer
+#define KBD_TIMER_MAX_TICKS     0xF000
+
+static void kbd_timer_arm(uint16_t ticks)
+{
+  OCR1A  = TCNT1 + ticks;
+  TIFR1  = (1 << OCF1A);   // forget a match that happened before
+  TIMSK1 |= (1 << OCIE1A);
+}
+
+ISR(TIMER1_COMPA_vect)
+{
+  kbd_emitter.poll();  // whatever is due
+
+  if (kbd_emitter.idle()) {
+    TIMSK1 &= ~(1 << OCIE1A);
+    return;
+  }
+
+  const int32_t remaining_us = (int32_t) (kbd_emitter.get_due_us() - micros());
+  uint32_t      ticks        = (remaining_us > 0) ? (uint32_t) remaining_us * KBD_TIMER_TICKS_PER_US : 0;
+  if (ticks < KBD_TIMER_MIN_TICKS) ticks = KBD_TIMER_MIN_TICKS;
+  if (ticks > KBD_TIMER_MAX_TICKS) ticks = KBD_TIMER_MAX_TICKS;
+  kbd_timer_arm(ticks);
+}
+
+// Starts the interrupt on newly queued events.  It only stops itself after finding the
+// emitter idle, with interrupts off here, so no event can be left behind.
+static void kbd_timer_start()
+{
+  noInterrupts();
+  if (!(TIMSK1 & (1 << OCIE1A))) kbd_timer_arm(KBD_TIMER_MIN_TICKS);
+  interrupts();
+}
+
+// ----- UART: interrupt driven receive ring, blocking transmit -----
+//
+// Replaces the Arduino Serial object (and its 64 byte buffer), which must then not be used
+// anywhere in the sketch: HardwareSerial defines the same USART_RX_vect interrupt.
+//
+// head is only written by the interrupt handler and tail by loop().  Both are 16 bits, so
+// loop() reads head and writes tail with interrupts off (ATOMIC_BLOCK); the interrupt
+// handler can't be interrupted.
+//
+// With XON/XOFF flow control (^FX^), the interrupt handler sends XOFF when the ring fills
+// past KBD_RX_XOFF_LEVEL, and loop() sends XON once it has drained it to KBD_RX_XON_LEVEL.
+// The bytes above the XOFF level leave room for what the host (and its USB serial chip)
+// still sends before it stops.
+
+#define KBD_UART_BAUD       115200
+#define KBD_RX_RING_SIZE    1024     // bytes, power of 2
+#define KBD_RX_XOFF_LEVEL   768
+#define KBD_RX_XON_LEVEL    256
+
+#define KBD_XON   0x11  // DC1, CTRL-Q (no key)
+#define KBD_XOFF  0x13  // DC3, CTRL-S (no key)
+
+static_assert((KBD_RX_RING_SIZE & (KBD_RX_RING_SIZE - 1)) == 0, "KBD_RX_RING_SIZE must be a power of 2");
+static_assert(KBD_RX_XON_LEVEL < KBD_RX_XOFF_LEVEL && KBD_RX_XOFF_LEVEL < KBD_RX_RING_SIZE, "bad receive ring watermarks");
+
+static uint8_t           kbd_rx_ring[KBD_RX_RING_SIZE];
+static volatile uint16_t kbd_rx_head;      // next byte to write
+static volatile uint16_t kbd_rx_tail;      // next byte to read
+static volatile uint16_t kbd_rx_overruns;  // bytes lost, ring full or UART data overrun
+static volatile uint8_t  kbd_rx_flow;      // KBD_FLOW_NONE or KBD_FLOW_XON_XOFF
+static volatile bool     kbd_rx_stopped;   // XOFF sent, XON not yet
+
+static void kbd_uart_write(char ch)
+{
+  while (!(UCSR0A & (1 << UDRE0))) { }
+  UDR0 = ch;
+}
+
+ISR(USART_RX_vect)
+{
+  const bool     overrun = (UCSR0A & (1 << DOR0)) != 0;  // read before UDR0
+  const uint8_t  ch      = UDR0;
+  const uint16_t head    = kbd_rx_head;
+
+  if (overrun) kbd_rx_overruns++;
+
+  if ((uint16_t) (head - kbd_rx_tail) >= KBD_RX_RING_SIZE) {
+    kbd_rx_overruns++;
+    return;
+  }
+  kbd_rx_ring[head & (KBD_RX_RING_SIZE - 1)] = ch;
+  kbd_rx_head = head + 1;
+
+  if ((kbd_rx_flow == KBD_FLOW_XON_XOFF) && !kbd_rx_stopped &&
+      ((uint16_t) (head + 1 - kbd_rx_tail) >= KBD_RX_XOFF_LEVEL))
+  {
+    kbd_uart_write(KBD_XOFF);  // the transmitter is idle but for the boot banner: no real wait
+    kbd_rx_stopped = true;
+  }
+}
+
+// 8N1, double speed (U2X0) as the Arduino core does: 2.1% error at 115200 baud on a 16MHz Nano
+static void kbd_uart_begin()
+{
+  UCSR0A = (1 << U2X0);
+  UBRR0  = (F_CPU / 4 / KBD_UART_BAUD - 1) / 2;
+  UCSR0C = (1 << UCSZ01) | (1 << UCSZ00);
+  UCSR0B = (1 << RXEN0) | (1 << TXEN0) | (1 << RXCIE0);
+}
+
+// Takes the next received byte, returns false when there is none
+static bool kbd_uart_read(uint8_t & ch)
+{
+  uint16_t head;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { head = kbd_rx_head; }
+
+  const uint16_t tail = kbd_rx_tail;  // only written here
+  if (head == tail) return false;
+
+  ch = kbd_rx_ring[tail & (KBD_RX_RING_SIZE - 1)];
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    kbd_rx_tail = tail + 1;
+
+    // With interrupts off, so XON can't cross an XOFF sent by the interrupt handler
+    if (kbd_rx_stopped && ((uint16_t) (kbd_rx_head - (tail + 1)) <= KBD_RX_XON_LEVEL)) {
+      kbd_uart_write(KBD_XON);
+      kbd_rx_stopped = false;
+    }
+  }
+  return true;
+}
+
+// ^FN^ ^FX^.  The Nano has no RTS/CTS line to the host: ^FH^ is ignored.
+static void kbd_uart_set_flow_control(uint8_t flow)
+{
+  if ((flow != KBD_FLOW_NONE) && (flow != KBD_FLOW_XON_XOFF)) return;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    if (kbd_rx_stopped) kbd_uart_write(KBD_XON);  // don't leave the host stopped
+    kbd_rx_stopped = false;
+    kbd_rx_flow    = flow;
+  }
+}
+
+// Prints a string in RAM, or in flash (PSTR()) with kbd_uart_print_P()
+static void kbd_uart_print(const char * s)   { while (*s) kbd_uart_write(*s++); }
+static void kbd_uart_print_P(const char * s) { for (char ch; (ch = pgm_read_byte(s)) != 0; s++) kbd_uart_write(ch); }
+
+void setup() {
+
+  for (uint8_t i = 0; i < (uint8_t) KbdLine::COUNT; i++) {
+    pinMode(kbd_pins[i], INPUT);
+    digitalWrite(kbd_pins[i], LOW);
+  }
+
+  // Timer1 in normal mode (no PWM on D9 / D10, they are keyboard lines), 2MHz
+  TCCR1A = 0;
+  TCCR1B = (1 << CS11);
+  TIMSK1 = 0;
+
+  kbd_uart_begin();  // KBD_UART_BAUD: 9600, 38400 and 57600 were also used
+  kbd_uart_print_P(PSTR("Serial connection established! "));
+  kbd_uart_print(kbd_translator.get_profile().name);
+  kbd_uart_print_P(PSTR("\r\n"));
+}
+
+// The input waits in the receive ring.  A byte is only taken from it when the emitter
+// queue has room for all the events it can give.  The keys are strobed by the Timer1
+// interrupt: nothing here waits for the keyboard, so the input is drained while keys are
+// strobed and ^Dx^ delays run.
+
+void loop() {
+
+  bool queued = false;
+
+  uint8_t ch;
+
+  while ((kbd_emitter.space() >= KbdTranslator::MAX_EVENTS_PER_BYTE) && kbd_uart_read(ch))
+  {
+    KbdEvent      events[KbdTranslator::MAX_EVENTS_PER_BYTE];
+    const uint8_t count = kbd_translator.put(ch, events);
+
+    if ((count == 1) && (events[0].type == KbdEventType::MODE) && (kbd_mode_arg_mode(events[0].value) == KbdMode::FLOW_CONTROL)) {
+      kbd_uart_set_flow_control(kbd_mode_arg_value(events[0].value));
+    }
+    queued |= (kbd_emitter.emit(events, count) != 0);
+  }
+
+  if (queued) kbd_timer_start();
+}
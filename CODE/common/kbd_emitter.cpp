@@ -0,0 +1,117 @@
+// Cooperative emitter.  See kbd_emitter.hpp.
+
+#include "kbd_emitter.hpp"
+
+size_t
+KbdEmitter::emit(const KbdEvent * events, size_t count)
+{
+  size_t i;
+
+  for (i = 0; i < count; i++) {
+    if (!queue.push(events[i])) break;
+  }
+  queue.count_dropped(count - i);  // never waits: the events left out are lost to the caller
+  return i;
+}
+
+void
+KbdEmitter::poll()
+{
+  // Several steps can be due at once (timing events, a zero setup time...)
+  for (;;) {
+    const uint32_t now = hal.now_us();
+
+    if (phase == Phase::IDLE) {
+      if (queue.empty()) return;
+    }
+    else if ((int32_t) (now - due_us) < 0) {
+      return;
+    }
+    if (!step(now)) return;
+  }
+}
+
+bool
+KbdEmitter::step(uint32_t now)
+{
+  switch (phase) {
+    case Phase::IDLE:
+      // A gap that ended long ago must not look like one in the future once the clock wraps
+      if ((uint32_t) (earliest_strobe_us - now) > timing.gap_us) earliest_strobe_us = now;
+      return next(now);
+
+    case Phase::STROBE_ON:
+      hal.set_strobe(true);   // trigger ON  the STROBE for the scancode being pressed
+      due_us  = now + timing.strobe_us;  // from now: a late poll must not shorten the strobe
+      phase   = Phase::STROBE_OFF;
+      return true;
+
+    case Phase::STROBE_OFF:
+      hal.set_strobe(false);  // trigger OFF the STROBE
+      earliest_strobe_us = now + timing.gap_us;
+      due_us = now + timing.hold_us;  // latched on the release: lines held
+      phase  = Phase::HOLD;
+      return true;
+
+    case Phase::HOLD:
+      return next(now);
+
+    case Phase::WAIT:
+      return next(due_us);
+  }
+  return false;
+}
+
+// Schedules the next queued event from t.  The data lines of a key are set up right away,
+// so the setup time runs within the gap that follows the previous strobe (after its hold).
+bool
+KbdEmitter::next(uint32_t t)
+{
+  KbdEvent event;
+
+  while (queue.pop(event)) {
+    switch (event.type) {
+      case KbdEventType::KEY:
+        // Pull "down" whichever bits in the scan code are 0's (and the parity)
+        hal.set_data_lines(event.value);
+        due_us = t + timing.setup_us;
+        if ((int32_t) (earliest_strobe_us - due_us) > 0) due_us = earliest_strobe_us;
+        phase = Phase::STROBE_ON;
+        return true;
+
+      case KbdEventType::DELAY:
+        hal.release_data_lines();
+        due_us = t + (uint32_t) event.value * 1000;
+        phase  = Phase::WAIT;
+        return true;
+
+      case KbdEventType::SETUP_US:
+        timing.setup_us = event.value;
+        break;
+      case KbdEventType::STROBE_US:
+        timing.strobe_us = event.value;
+        break;
+      case KbdEventType::HOLD_US:
+        timing.hold_us = event.value;
+        break;
+      case KbdEventType::GAP_US:
+        timing.gap_us = event.value;
+        break;
+      default:
+        break;
+    }
+  }
+
+  hal.release_data_lines();  // revert back whatever was "pulled down"
+  phase = Phase::IDLE;
+  return false;
+}
+
+void
+KbdEmitter::flush()
+{
+  while (!idle() || !queue.empty()) {
+    poll();
+    if (!idle()) hal.wait_until_us(due_us);
+  }
+}
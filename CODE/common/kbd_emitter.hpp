@@ -0,0 +1,74 @@
+// Cooperative emitter: queues translated events in a KbdEventRing, and plays
+// them on the keyboard lines through a KbdHal one step at a time, without ever
+// waiting.  Each step (data lines set up, strobe pulled, strobe released, end
+// of a delay) is scheduled on the HAL microsecond clock; poll() runs the steps
+// that are due, so the firmware loop keeps reading its input in between.
+//
+// The key timing comes from the keyboard profile, and can be adjusted with the
+// ^TSxx^ ^TWxx^ ^THxx^ ^TGxx^ parse keys.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "kbd_events.hpp"
+#include "kbd_event_ring.hpp"
+#include "kbd_hal.hpp"
+#include "kbd_profile.hpp"
+
+class KbdEmitter
+{
+  public:
+    static const uint8_t QUEUE_SIZE = 64;  // events
+
+    typedef KbdEventRing<uint8_t, QUEUE_SIZE> Queue;
+
+    KbdEmitter(KbdHal & hal, const KbdProfile & profile = kbd_profile_5110) :
+      hal(hal), timing(profile.timing), phase(Phase::IDLE), due_us(0), earliest_strobe_us(0) { }
+
+    // ----- Producer side -----
+
+    // Queues as many of the events as there is room for, and returns how many were.  The
+    // events left out count as overflows of the queue: check space() first.
+    size_t emit(const KbdEvent * events, size_t count);
+
+    // Room left, in events
+    inline size_t space() const { return queue.space(); }
+
+    // ----- Consumer side -----
+
+    // Runs the steps that are due, if any.  Returns at once.
+    void poll();
+
+    // Runs the step due at now (or starts on a newly queued event when idle).  Returns false
+    // once the queue is drained and every line released, else the next step is due at get_due_us().
+    bool step(uint32_t now);
+
+    // Polls until the queue is drained, waiting through the HAL in between.
+    void flush();
+
+    inline bool             idle() const { return phase == Phase::IDLE; }
+    inline uint32_t   get_due_us() const { return due_us; }
+    inline const Queue & get_queue() const { return queue; }
+
+    inline const KbdTiming & get_timing() const { return timing; }
+
+  private:
+    enum class Phase : uint8_t {
+      IDLE,        // queue empty, lines released
+      STROBE_ON,   // data lines set up, pull the strobe when due
+      STROBE_OFF,  // release the strobe when due
+      HOLD,        // data lines held after the strobe, until due
+      WAIT         // end of a delay: look at the next event when due
+    };
+
+    bool next(uint32_t t);
+
+    KbdHal &       hal;
+    Queue          queue;
+    KbdTiming      timing;
+    volatile Phase phase;
+    uint32_t       due_us;              // time of the next step
+    uint32_t       earliest_strobe_us;  // end of the gap after the last strobe
+};
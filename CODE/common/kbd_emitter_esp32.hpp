@@ -0,0 +1,220 @@
+// Interrupt driven emitter for the ESP32 firmwares.  Not part of the host
+// build.
+//
+// emit() only queues the events (in a lock-free KbdEventRing) and returns: a
+// hardware timer interrupt plays them on the keyboard lines, so the input task
+// keeps reading and translating while a key is strobed or a ^Dx^ delay runs.
+// Each edge is scheduled on the timer counter (1 MHz) relative to the previous
+// one, and the interrupt handler and all it touches live in IRAM / DRAM: the
+// strobe timing depends neither on the load of the other interrupts (bluetooth
+// stack) nor on flash cache misses.
+//
+// Uses the legacy timer driver of ESP-IDF 4.4 (driver/timer.h), on timer 0 of
+// group 0.  Like kbd_hal_esp32.hpp, meant to be included by the main source
+// file of a firmware only.
+
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/timer.h"
+#include "esp_attr.h"
+
+#include "kbd_events.hpp"
+#include "kbd_event_ring.hpp"
+#include "kbd_hal_esp32.hpp"
+#include "kbd_profile.hpp"
+
+class Esp32KbdIsrEmitter
+{
+  public:
+    static const uint16_t QUEUE_SIZE = 256;  // events
+
+    typedef KbdEventRing<uint16_t, QUEUE_SIZE> Queue;
+
+    Esp32KbdIsrEmitter(const KbdProfile & profile = kbd_profile_5110) :
+      timing(profile.timing),
+      phase(Phase::IDLE), alarm_us(0), earliest_strobe_us(0), lock(portMUX_INITIALIZER_UNLOCKED) { }
+
+    // Starts the timer.  Call once, before any emit().
+    bool begin()
+    {
+      timer_config_t config = {};
+      config.divider     = TIMER_DIVIDER;
+      config.counter_dir = TIMER_COUNT_UP;
+      config.counter_en  = TIMER_PAUSE;
+      config.alarm_en    = TIMER_ALARM_EN;
+      config.auto_reload = TIMER_AUTORELOAD_DIS;
+      config.intr_type   = TIMER_INTR_LEVEL;
+
+      return (timer_init(TIMER_GROUP, TIMER_INDEX, &config)                                        == ESP_OK) &&
+             (timer_set_counter_value(TIMER_GROUP, TIMER_INDEX, 0)                                 == ESP_OK) &&
+             (timer_set_alarm_value(TIMER_GROUP, TIMER_INDEX, NEVER)                               == ESP_OK) &&
+             (timer_enable_intr(TIMER_GROUP, TIMER_INDEX)                                          == ESP_OK) &&
+             (timer_isr_callback_add(TIMER_GROUP, TIMER_INDEX, on_alarm, this, ESP_INTR_FLAG_IRAM) == ESP_OK) &&
+             (timer_start(TIMER_GROUP, TIMER_INDEX)                                                == ESP_OK);
+    }
+
+    // Queues the events, only waiting when the queue is full.
+    void emit(const KbdEvent * events, size_t count)
+    {
+      for (size_t i = 0; i < count; i++) put(events[i]);
+      restart();
+    }
+
+    void emit(const KbdEvent & event) { emit(&event, 1); }
+
+    inline const Queue & get_queue() const { return queue; }
+
+  private:
+    static const timer_group_t TIMER_GROUP   = TIMER_GROUP_0;
+    static const timer_idx_t   TIMER_INDEX   = TIMER_0;
+    static const uint32_t      TIMER_DIVIDER = 80;          // 80 MHz APB clock: 1 us per count
+    static const uint64_t      NEVER         = UINT64_MAX;  // alarm value of an idle emitter
+    static const uint64_t      MIN_LEAD_US   = 2;           // from reading the counter to arming the alarm
+
+    enum class Phase : uint8_t {
+      IDLE,        // queue empty, lines released, no alarm
+      STROBE_ON,   // data lines set up, pull the strobe at the alarm
+      STROBE_OFF,  // release the strobe at the alarm
+      HOLD,        // data lines held after the strobe, until the alarm
+      WAIT         // gap, delay or restart: look at the next event at the alarm
+    };
+
+    // Only waits when the queue is full, letting the interrupt handler drain it.
+    // Nothing is dropped: an event that has to wait is counted once as blocked.
+    void put(const KbdEvent & event)
+    {
+      if (queue.push(event)) return;
+
+      queue.count_blocked();
+      do {
+        restart();
+        vTaskDelay(1);
+      } while (!queue.push(event));
+    }
+
+    // Restarts an idle emitter.  The handler only goes idle after finding the queue
+    // empty under the lock, so an event queued before is either seen by it, or by the
+    // test below.  The alarm is armed under the lock too, through the register
+    // accessors of set_alarm(): the timer driver functions would take the driver lock,
+    // which is held while calling on_alarm().
+    void restart()
+    {
+      if (queue.empty()) return;
+
+      portENTER_CRITICAL(&lock);
+      if (phase == Phase::IDLE) {
+        phase = Phase::WAIT;
+        set_alarm(0);  // as soon as possible
+      }
+      portEXIT_CRITICAL(&lock);
+    }
+
+    static bool IRAM_ATTR on_alarm(void * arg)
+    {
+      Esp32KbdIsrEmitter * self = (Esp32KbdIsrEmitter *) arg;
+      // The edges are timed from the schedule, not from the interrupt latency
+      const uint64_t       t    = self->alarm_us;
+
+      switch (self->phase) {
+        case Phase::STROBE_ON:
+          Esp32KbdHal::write_strobe(true);
+          self->set_alarm(t + self->timing.strobe_us);
+          self->phase = Phase::STROBE_OFF;
+          break;
+        case Phase::STROBE_OFF:
+          Esp32KbdHal::write_strobe(false);
+          self->earliest_strobe_us = t + self->timing.gap_us;
+          self->set_alarm(t + self->timing.hold_us);  // latched on the release: lines held
+          self->phase = Phase::HOLD;
+          break;
+        case Phase::HOLD:
+          self->next(t);
+          break;
+        case Phase::WAIT:
+          self->next(t);
+          break;
+        default:
+          break;
+      }
+      return false;  // no task to wake up
+    }
+
+    // Schedules the next event due at t.  The data lines of a key are set up right
+    // away, so the setup time runs within the gap that follows the previous strobe
+    // (after its hold).
+    void IRAM_ATTR next(uint64_t t)
+    {
+      KbdEvent event;
+
+      for (;;) {
+        if (!queue.pop(event)) {
+          portENTER_CRITICAL_ISR(&lock);
+          const bool empty = queue.empty();  // still, now that restart() can't look at phase
+          if (empty) {
+            // under the lock, so a restart by put() can't be overwritten
+            Esp32KbdHal::release_all_data_lines();
+            set_alarm(NEVER);
+            phase = Phase::IDLE;
+          }
+          portEXIT_CRITICAL_ISR(&lock);
+
+          if (empty) return;
+          continue;
+        }
+
+        switch (event.type) {
+          case KbdEventType::KEY: {
+            Esp32KbdHal::write_data_lines(event.value);
+            const uint64_t setup_done = t + timing.setup_us;
+            set_alarm((setup_done > earliest_strobe_us) ? setup_done : earliest_strobe_us);
+            phase = Phase::STROBE_ON;
+            return;
+          }
+          case KbdEventType::DELAY:
+            Esp32KbdHal::release_all_data_lines();
+            set_alarm(t + (uint64_t) event.value * 1000);
+            phase = Phase::WAIT;
+            return;
+          case KbdEventType::SETUP_US:
+            timing.setup_us = event.value;
+            break;
+          case KbdEventType::STROBE_US:
+            timing.strobe_us = event.value;
+            break;
+          case KbdEventType::HOLD_US:
+            timing.hold_us = event.value;
+            break;
+          case KbdEventType::GAP_US:
+            timing.gap_us = event.value;
+            break;
+          default:
+            break;
+        }
+      }
+    }
+
+    // An alarm set in the past would only fire once the counter wraps: the edge is
+    // moved to MIN_LEAD_US from now at the earliest (zero timings, interrupt latency),
+    // and the next ones are timed from there.
+    void IRAM_ATTR set_alarm(uint64_t t)
+    {
+      const uint64_t earliest = timer_group_get_counter_value_in_isr(TIMER_GROUP, TIMER_INDEX) + MIN_LEAD_US;
+      if (t < earliest) t = earliest;
+
+      alarm_us = t;
+      timer_group_set_alarm_value_in_isr(TIMER_GROUP, TIMER_INDEX, t);
+      timer_group_enable_alarm_in_isr(TIMER_GROUP, TIMER_INDEX);
+    }
+
+    Queue         queue;
+
+    // Only used by the interrupt handler once started
+    KbdTiming     timing;
+    volatile Phase phase;
+    uint64_t      alarm_us;            // timer count of the pending alarm
+    uint64_t      earliest_strobe_us;  // end of the gap after the last strobe
+
+    portMUX_TYPE  lock;                // guards phase between put() and the interrupt handler
+};
@@ -0,0 +1,91 @@
+// Lock-free single producer / single consumer ring of KbdEvents.
+//
+// Sits between the translator (producer: loop() or the input task) and the
+// emitter (consumer: a poll, or a timer interrupt), so the input side keeps
+// reading while keys are strobed and ^Dx^ delays run: a delay is just one more
+// event, the emitter schedules it instead of blocking.
+//
+// head is only written by the producer, and tail by the consumer.  Both are
+// free running counters (the slot is counter % N), published with release
+// stores and read with acquire loads, so no lock or interrupt masking is needed
+// on either side.  Index is the type of the counters: uint8_t on the Nano,
+// where a byte is loaded and stored atomically.
+//
+// The producer also keeps the high-water mark of the ring, to measure the backlog
+// directly, and counts the events that found it full: the ones it waited for room
+// for (blocked, counted once however long the wait), and the ones it dropped
+// (overflows).  A push that fails counts nothing: only the producer knows which.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "kbd_events.hpp"
+
+// Called from interrupt handlers that must not touch the flash (ESP32 IRAM): never out of line.
+#define KBD_ALWAYS_INLINE inline __attribute__((always_inline))
+
+template <typename Index, size_t N>
+class KbdEventRing
+{
+  public:
+    static_assert((N & (N - 1)) == 0, "the size of a KbdEventRing must be a power of 2");
+    static_assert(N <= ((size_t) 1 << (8 * sizeof(Index) - 1)), "Index is too small to count the events of the ring");
+
+    KbdEventRing() : head(0), tail(0), high_water(0), blocked(0), overflows(0) { }
+
+    // ----- Producer side -----
+
+    KBD_ALWAYS_INLINE bool push(const KbdEvent & event)
+    {
+      const Index h = head;  // only written by the producer
+      const Index used = (Index) (h - __atomic_load_n(&tail, __ATOMIC_ACQUIRE));
+
+      if (used >= N) return false;
+      events[h & (N - 1)] = event;
+      __atomic_store_n(&head, (Index) (h + 1), __ATOMIC_RELEASE);
+
+      if (used >= high_water) high_water = used + 1;
+      return true;
+    }
+
+    KBD_ALWAYS_INLINE size_t space() const { return N - count(); }
+
+    inline void count_blocked()             { blocked++; }
+    inline void count_dropped(size_t count) { overflows += count; }
+
+    // ----- Consumer side -----
+
+    KBD_ALWAYS_INLINE bool pop(KbdEvent & event)
+    {
+      const Index t = tail;  // only written by the consumer
+
+      if (t == __atomic_load_n(&head, __ATOMIC_ACQUIRE)) return false;
+
+      event = events[t & (N - 1)];
+      __atomic_store_n(&tail, (Index) (t + 1), __ATOMIC_RELEASE);
+      return true;
+    }
+
+    // ----- Either side -----
+
+    KBD_ALWAYS_INLINE size_t count() const
+    {
+      return (Index) (__atomic_load_n(&head, __ATOMIC_ACQUIRE) - __atomic_load_n(&tail, __ATOMIC_ACQUIRE));
+    }
+
+    KBD_ALWAYS_INLINE bool empty() const { return count() == 0; }
+
+    inline size_t   get_high_water() const { return high_water; }  // most events ever queued at once
+    inline uint32_t    get_blocked() const { return blocked;    }  // events that waited for room
+    inline uint32_t  get_overflows() const { return overflows;  }  // events dropped because the ring was full
+
+  private:
+    KbdEvent events[N];
+    Index    head;        // next slot to write
+    Index    tail;        // next slot to read
+    Index    high_water;
+    uint32_t blocked;
+    uint32_t overflows;
+};
@@ -0,0 +1,28 @@
+// Output events of the translation core.
+//
+// The translator turns input bytes into a compact stream of events, and an
+// emitter (blocking, timer or ISR driven depending on the firmware) plays them
+// on the keyboard lines.
+
+#pragma once
+
+#include <stdint.h>
+
+#include "kbd_keys.hpp"
+
+enum class KbdEventType : uint8_t {
+  KEY,    // press the KbdKey in value
+  DELAY,  // wait value milliseconds before the next event
+  MODE,   // a mode changed, value as built by kbd_mode_arg()
+
+  // Emitter timing changes (^TS^ ^TW^ ^TH^ ^TG^), value in microseconds
+  SETUP_US,   // data lines stable before the strobe
+  STROBE_US,  // strobe width
+  HOLD_US,    // data lines stable after the strobe
+  GAP_US      // strobe released between two keys
+};
+
+struct KbdEvent {
+  KbdEventType type;
+  uint16_t     value;
+};
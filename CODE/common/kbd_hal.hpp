@@ -0,0 +1,84 @@
+// Hardware abstraction used by the shared IBM 5110 translation core.
+//
+// Each firmware (Arduino Nano, ESP32 serial, ESP32 bluetooth) provides one
+// implementation of KbdHal for its own pin wiring.  The translation core only
+// ever talks to the keyboard connector through this interface, which is what
+// allows the very same core to also be built as a plain Linux library.
+
+#pragma once
+
+#include <stdint.h>
+
+#include "kbd_keys.hpp"
+
+// The lines of the green KEYBOARD header on the IBM 5110.  KBD_0 carries the
+// most significant bit of a scan code (0x80) and KBD_7 the least significant
+// one (0x01).
+enum class KbdLine : uint8_t {
+  KBD_0, KBD_1, KBD_2, KBD_3, KBD_4, KBD_5, KBD_6, KBD_7,
+  KBD_P,
+  KBD_STROBE,
+  COUNT
+};
+
+// Bit of each KbdLine in a set of lines
+constexpr uint16_t kbd_line_bit(KbdLine line) { return (uint16_t) (1 << (uint8_t) line); }
+
+// The lines pulled down to send a scan code: its 0 bits (KBD_0 is bit 0x80, KBD_7 is
+// bit 0x01), and KBD_P when its parity is even.
+constexpr uint16_t kbd_scan_code_lines(uint8_t scan_code, uint8_t bit = 0)
+{
+  return (bit >= 8) ? (kbd_parity(scan_code) ? 0 : kbd_line_bit(KbdLine::KBD_P)) :
+                      (uint16_t) (((scan_code & (0x80 >> bit)) ? 0 : (1 << bit)) | kbd_scan_code_lines(scan_code, bit + 1));
+}
+
+// ----- Compile time pin masks -----
+//
+// A HAL gives the bit of the pin of each line in one of its port registers (T), and
+// gets, for each of the 256 scan codes, the mask of the pins to pull down.  A whole
+// key is then set up with one or two register writes, and all its lines change at once.
+
+template <typename T>
+struct KbdPinMasks {
+  T masks[256];
+
+  constexpr T operator[](size_t i) const { return masks[i]; }
+};
+
+template <typename T>
+constexpr T kbd_pin_mask(uint16_t lines, const T (& pin_bits)[(uint8_t) KbdLine::COUNT], uint8_t line = 0)
+{
+  return (line >= (uint8_t) KbdLine::COUNT) ? 0 :
+         (T) ((((lines >> line) & 1) ? pin_bits[line] : 0) | kbd_pin_mask(lines, pin_bits, line + 1));
+}
+
+template <typename T, size_t... I>
+constexpr KbdPinMasks<T> kbd_pin_masks(const T (& pin_bits)[(uint8_t) KbdLine::COUNT], KbdIndexList<I...>)
+{
+  return KbdPinMasks<T> {{ kbd_pin_mask(kbd_scan_code_lines(I), pin_bits)... }};
+}
+
+template <typename T>
+constexpr KbdPinMasks<T> kbd_pin_masks(const T (& pin_bits)[(uint8_t) KbdLine::COUNT])
+{
+  return kbd_pin_masks(pin_bits, typename KbdMakeIndexList<256>::type());
+}
+
+class KbdHal
+{
+  public:
+    // A line is "pressed" by pulling it down (pin driven LOW), and released by
+    // letting it float again (pin configured as an INPUT).
+    //
+    // set_data_lines() switches the 8 data lines and KBD_P from whatever they were to
+    // the lines of key (kbd_scan_code_lines()), all at once.
+    virtual void     set_data_lines(KbdKey key) = 0;
+    virtual void release_data_lines() = 0;
+    virtual void         set_strobe(bool pulled_low) = 0;
+
+    // Free running microsecond clock (wraps around every 71 minutes), and a wait for
+    // a deadline on that clock.  Waits are short (a strobe, a ^Dx^ delay): a firmware
+    // may spin, and should yield to other tasks for the longer ones.
+    virtual uint32_t       now_us() = 0;
+    virtual void wait_until_us(uint32_t deadline_us) = 0;
+};
@@ -0,0 +1,107 @@
+// KbdHal for the ESP32 firmwares (serial translator and bluetooth adapter),
+// which share the same wiring to the IBM keyboard connector.  Not part of the
+// host build.
+
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"  // vTaskDelay
+#include "esp_timer.h"      // esp_timer_get_time
+#include "esp_attr.h"       // DRAM_ATTR
+#include "driver/gpio.h"    // gpio_XXX functions
+#include "soc/gpio_struct.h" // GPIO registers
+
+#include "kbd_hal.hpp"
+
+//               verified      ESP32 board label            Arduino pin#
+#define PIN_KBD_P       (gpio_num_t)0   // D0                           2
+
+#define PIN_KBD_7       (gpio_num_t)15  // D15                          3
+#define PIN_KBD_6       (gpio_num_t)2   // D2                           4
+#define PIN_KBD_5       (gpio_num_t)4   // D4                           5
+#define PIN_KBD_4       (gpio_num_t)16  // RX2                          6
+#define PIN_KBD_3       (gpio_num_t)17  // TX2                          7
+#define PIN_KBD_2       (gpio_num_t)5   // D5                           8
+#define PIN_KBD_1       (gpio_num_t)18  // D18                          9 
+#define PIN_KBD_0       (gpio_num_t)19  // D19                          10
+
+#define PIN_KBD_STROBE  (gpio_num_t)21  // D21                          11
+
+// Bit of the pin of each KbdLine in the GPIO.enable registers, in the order of the KbdLine enumeration.
+static constexpr uint32_t esp32_kbd_pin_bits[(uint8_t) KbdLine::COUNT] = {
+  1u << PIN_KBD_0, 1u << PIN_KBD_1, 1u << PIN_KBD_2, 1u << PIN_KBD_3,
+  1u << PIN_KBD_4, 1u << PIN_KBD_5, 1u << PIN_KBD_6, 1u << PIN_KBD_7,
+  1u << PIN_KBD_P,
+  1u << PIN_KBD_STROBE
+};
+
+static_assert((PIN_KBD_0 < 32) && (PIN_KBD_1 < 32) && (PIN_KBD_2 < 32) && (PIN_KBD_3 < 32) && (PIN_KBD_4 < 32) &&
+              (PIN_KBD_5 < 32) && (PIN_KBD_6 < 32) && (PIN_KBD_7 < 32) && (PIN_KBD_P < 32) && (PIN_KBD_STROBE < 32),
+              "the pin masks only cover GPIO 0 to 31 (GPIO.enable, not GPIO.enable1)");
+
+class Esp32KbdHal : public KbdHal
+{
+  public:
+    // Pin of each KbdLine.  In DRAM, as the interrupt driven emitter (kbd_emitter_esp32.hpp)
+    // must not touch the flash.
+    static const gpio_num_t pins[(uint8_t) KbdLine::COUNT];
+
+    // Pins to pull down for each scan code.  In DRAM too.
+    static const KbdPinMasks<uint32_t> key_masks;
+
+    static const uint32_t DATA_LINES_MASK = kbd_pin_mask((uint16_t) (kbd_line_bit(KbdLine::KBD_STROBE) - 1), esp32_kbd_pin_bits);
+    static const uint32_t STROBE_MASK     = 1u << PIN_KBD_STROBE;
+
+    // A pin is pulled down by enabling its output (level set to LOW by configure_pins()).  Two
+    // register writes for a whole key, callable from an interrupt handler.
+    static inline void IRAM_ATTR write_data_lines(KbdKey key)
+    {
+      const uint32_t mask = key_masks.masks[kbd_key_code(key)];
+      GPIO.enable_w1tc = DATA_LINES_MASK & ~mask;
+      GPIO.enable_w1ts = mask;
+    }
+    static inline void IRAM_ATTR release_all_data_lines() { GPIO.enable_w1tc = DATA_LINES_MASK; }
+    static inline void IRAM_ATTR write_strobe(bool pulled_low)
+    {
+      if (pulled_low) GPIO.enable_w1ts = STROBE_MASK; else GPIO.enable_w1tc = STROBE_MASK;
+    }
+
+    void     set_data_lines(KbdKey key)      { write_data_lines(key); }
+    void release_data_lines()                { release_all_data_lines(); }
+    void         set_strobe(bool pulled_low) { write_strobe(pulled_low); }
+
+    uint32_t now_us() { return (uint32_t) esp_timer_get_time(); }
+
+    // vTaskDelay() counts in ticks (10ms at the default 100Hz), so it only sleeps through the
+    // whole ticks of a wait, leaving the other tasks run; the rest is spun on esp_timer.
+    void wait_until_us(uint32_t deadline_us)
+    {
+      const uint32_t  remaining = deadline_us - now_us();
+      const TickType_t    ticks = ((int32_t) remaining > 0) ? remaining / (portTICK_PERIOD_MS * 1000) : 0;
+
+      if (ticks > 0) vTaskDelay(ticks);
+      while ((int32_t) (deadline_us - now_us()) > 0) { }
+    }
+
+    // All lines released (INPUT), with a LOW output level ready for when they get pulled down.
+    // KBD_P is on GPIO0, a strapping pin: it is reset too, as the firmwares always did.  The
+    // boot mode is latched at chip reset, before this runs, and the pin is left released.
+    static void configure_pins()
+    {
+      for (uint8_t i = 0; i < (uint8_t) KbdLine::COUNT; i++) {
+        gpio_reset_pin(pins[i]);
+        gpio_set_direction(pins[i], GPIO_MODE_INPUT);
+        gpio_set_level(pins[i], 0);
+      }
+    }
+};
+
+// Pin of each KbdLine, in the order of the KbdLine enumeration.  This header is meant
+// to be included by the main source file of a firmware only.
+DRAM_ATTR const gpio_num_t Esp32KbdHal::pins[(uint8_t) KbdLine::COUNT] = {
+  PIN_KBD_0, PIN_KBD_1, PIN_KBD_2, PIN_KBD_3, PIN_KBD_4, PIN_KBD_5, PIN_KBD_6, PIN_KBD_7,
+  PIN_KBD_P,
+  PIN_KBD_STROBE
+};
+
+DRAM_ATTR const KbdPinMasks<uint32_t> Esp32KbdHal::key_masks = kbd_pin_masks(esp32_kbd_pin_bits);
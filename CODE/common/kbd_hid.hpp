@@ -0,0 +1,81 @@
+// HID keyboards (bluetooth adapter): usages of the keyboard page, and the table
+// of their keys on the IBM machine.
+//
+// A profile has one table giving the KbdKey of every (usage, modifiers), so a key
+// event from a HID keyboard takes a single lookup (KbdTranslator::put_hid()).  It
+// is built at compile time in kbd_profiles.cpp: most keys go through the ASCII
+// table of the profile and the characters of a US keyboard layout (kbd_hid_char()),
+// the others (arrows, HOLD, the CMD combinations) have their own scan codes.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "kbd_keys.hpp"
+
+// Usages 0x00 to 0x67 (keypad =), the keys of a standard 104 key keyboard
+static const uint8_t KBD_HID_USAGE_COUNT = 0x68;
+
+static const uint8_t KBD_HID_A         = 0x04;
+static const uint8_t KBD_HID_Z         = 0x1D;
+static const uint8_t KBD_HID_1         = 0x1E;
+static const uint8_t KBD_HID_ENTER     = 0x28;
+static const uint8_t KBD_HID_ESCAPE    = 0x29;
+static const uint8_t KBD_HID_MINUS     = 0x2D;
+static const uint8_t KBD_HID_EQUAL     = 0x2E;
+static const uint8_t KBD_HID_SLASH     = 0x38;
+static const uint8_t KBD_HID_CAPS_LOCK = 0x39;
+static const uint8_t KBD_HID_F1        = 0x3A;
+static const uint8_t KBD_HID_PAUSE     = 0x48;
+static const uint8_t KBD_HID_RIGHT     = 0x4F;
+static const uint8_t KBD_HID_LEFT      = 0x50;
+static const uint8_t KBD_HID_DOWN      = 0x51;
+static const uint8_t KBD_HID_UP        = 0x52;
+static const uint8_t KBD_HID_KP_SLASH  = 0x54;
+static const uint8_t KBD_HID_KP_STAR   = 0x55;
+static const uint8_t KBD_HID_KP_MINUS  = 0x56;
+static const uint8_t KBD_HID_KP_PLUS   = 0x57;
+static const uint8_t KBD_HID_KP_ENTER  = 0x58;
+static const uint8_t KBD_HID_KP_DOT    = 0x63;
+
+// Bits of the modifier byte of a report (left and right keys)
+static const uint8_t KBD_HID_CTRL  = 0x11;
+static const uint8_t KBD_HID_SHIFT = 0x22;
+
+// The table of a profile has one layer of KBD_HID_USAGE_COUNT keys per modifier: CTRL wins
+// over SHIFT, ALT and META are ignored.
+static const uint8_t KBD_HID_PLAIN_LAYER = 0;
+static const uint8_t KBD_HID_SHIFT_LAYER = 1;
+static const uint8_t KBD_HID_CTRL_LAYER  = 2;
+static const uint8_t KBD_HID_LAYER_COUNT = 3;
+
+static const size_t KBD_HID_KEY_COUNT = KBD_HID_LAYER_COUNT * KBD_HID_USAGE_COUNT;
+
+constexpr uint8_t kbd_hid_layer(uint8_t modifiers)
+{
+  return (modifiers & KBD_HID_CTRL)  ? KBD_HID_CTRL_LAYER  :
+         (modifiers & KBD_HID_SHIFT) ? KBD_HID_SHIFT_LAYER : KBD_HID_PLAIN_LAYER;
+}
+
+constexpr size_t kbd_hid_index(uint8_t layer, uint8_t usage) { return (size_t) layer * KBD_HID_USAGE_COUNT + usage; }
+
+constexpr bool kbd_hid_is_letter(uint8_t usage) { return (usage >= KBD_HID_A) && (usage <= KBD_HID_Z); }
+
+// Character of a key on a US layout (0: none), from A (0x04) to / (0x38), and on the keypad.
+// Keypad ENTER is a CR like ENTER.
+constexpr char kbd_hid_char(uint8_t usage, bool shift)
+{
+  return ((usage >= KBD_HID_A) && (usage <= KBD_HID_SLASH))
+           ? "aAbBcCdDeEfFgGhHiIjJkKlLmMnNoOpPqQrRsStTuUvVwWxXyYzZ1!2@3#4$5%6^7&8*9(0)"
+             "\r\r\033\033\b\b\t\t  -_=+[{]}\\|##;:'\"`~,<.>/?"[((usage - KBD_HID_A) << 1) + (shift ? 1 : 0)]
+           : ((usage >= KBD_HID_KP_SLASH) && (usage <= KBD_HID_KP_DOT))
+           ? "/*-+\r1234567890."[usage - KBD_HID_KP_SLASH]
+           : 0;
+}
+
+// CTRL-A to CTRL-Z (0: none)
+constexpr char kbd_hid_ctrl_char(uint8_t usage)
+{
+  return kbd_hid_is_letter(usage) ? (char) (usage - KBD_HID_A + 1) : 0;
+}
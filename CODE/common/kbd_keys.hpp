@@ -0,0 +1,80 @@
+// Packed IBM 5110 key codes, and the compile time helpers used to build the
+// translation tables out of plain scan code lists.
+//
+// A KbdKey packs a scan code (bits 0 to 7) with the parity bit the 5110 expects
+// for it (bit 8).  The parity bit for the 5110 is just a count of the number of
+// bits in the scancode (ODD is TRUE, EVEN is FALSE).  If the IBM 5110 does not
+// receive the expected parity signal for the corresponding scan code, the system
+// will stop/freeze/lockup (a RESET or power cycle is then required), so parity is
+// only ever computed here, at compile time, and checked with static_assert.
+//
+// Written for C++11 (the Arduino AVR toolchain), so no <utility> or loops in constexpr.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef uint16_t KbdKey;
+
+static const KbdKey KBD_KEY_NONE     = 0x0000;  // scan code 0x00 means "no key"
+static const KbdKey KBD_KEY_PARITY   = 0x0100;
+static const KbdKey KBD_KEY_COMPOSED = 0x8000;  // not a key: bits 0 to 7 index a sequence of keys
+
+// Parity of the 8 bits of a scan code: the 4 bit parity of (high nibble ^ low nibble),
+// looked up in the 16 bit constant 0x6996.
+constexpr bool kbd_parity(uint8_t scan_code)
+{
+  return ((0x6996 >> ((scan_code ^ (scan_code >> 4)) & 0x0F)) & 0x01) != 0;
+}
+
+constexpr KbdKey kbd_key(uint8_t scan_code)
+{
+  return (KbdKey) (scan_code | (kbd_parity(scan_code) ? KBD_KEY_PARITY : 0));
+}
+
+constexpr uint8_t kbd_key_code  (KbdKey key) { return (uint8_t) (key & 0xFF); }
+constexpr bool    kbd_key_parity(KbdKey key) { return (key & KBD_KEY_PARITY) != 0; }
+
+constexpr KbdKey  kbd_composed_key   (uint8_t index) { return (KbdKey) (KBD_KEY_COMPOSED | index); }
+constexpr bool    kbd_key_is_composed(KbdKey key)    { return (key & KBD_KEY_COMPOSED) != 0; }
+constexpr uint8_t kbd_key_composition(KbdKey key)    { return (uint8_t) (key & 0xFF); }
+
+// ----- Compile time table generation -----
+
+template <size_t... I> struct KbdIndexList {};
+
+template <size_t N, size_t... I>
+struct KbdMakeIndexList : KbdMakeIndexList<N - 1, N - 1, I...> {};
+
+template <size_t... I>
+struct KbdMakeIndexList<0, I...> { typedef KbdIndexList<I...> type; };
+
+template <size_t N>
+struct KbdKeyTable {
+  KbdKey keys[N];
+
+  constexpr KbdKey operator[](size_t i) const { return keys[i]; }
+};
+
+template <size_t N, size_t... I>
+constexpr KbdKeyTable<N> kbd_key_table(const uint8_t (& scan_codes)[N], KbdIndexList<I...>)
+{
+  return KbdKeyTable<N> {{ kbd_key(scan_codes[I])... }};
+}
+
+// Builds the packed KbdKey table of a plain list of scan codes.
+template <size_t N>
+constexpr KbdKeyTable<N> kbd_key_table(const uint8_t (& scan_codes)[N])
+{
+  return kbd_key_table(scan_codes, typename KbdMakeIndexList<N>::type());
+}
+
+// True when every key of the table carries the parity bit of its own scan code.
+template <size_t N>
+constexpr bool kbd_key_table_valid(const KbdKeyTable<N> & table, size_t i = 0)
+{
+  return (i >= N) ||
+         ((kbd_key_is_composed(table[i]) || (kbd_key_parity(table[i]) == kbd_parity(kbd_key_code(table[i])))) &&
+          kbd_key_table_valid(table, i + 1));
+}
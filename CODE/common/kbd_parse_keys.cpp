@@ -0,0 +1,107 @@
+// Registry of the "^XX^" parse keys.  See kbd_parse_keys.hpp.
+
+#include "kbd_parse_keys.hpp"
+#include "kbd_progmem.hpp"
+
+#define KEY(c0, c1, scan_code)   { { c0, c1 }, KbdAction::KEY,      kbd_key(scan_code) }
+#define DELAY(c0, c1, ms)        { { c0, c1 }, KbdAction::DELAY,    ms }
+#define MODE(c0, c1, m, value)   { { c0, c1 }, KbdAction::SET_MODE, kbd_mode_arg(KbdMode::m, value) }
+#define TIMING(c0, c1, event)    { { c0, c1 }, KbdAction::TIMING,   (uint16_t) KbdEventType::event }
+
+static constexpr KbdParseKey parse_keys[] KBD_PROGMEM = {
+  KEY  ('L', 'E', 0x34),  // LEFT ARROW
+  KEY  ('R', 'I', 0xB4),  // RIGHT ARROW
+  KEY  ('U', 'P', 0xDF),  // UP ARROW
+  KEY  ('D', 'O', 0x4F),  // DOWN ARROW
+
+  KEY  ('S', 'U', 0xDE),  // SHIFT-UP ARROW
+  KEY  ('S', 'D', 0x4E),  // SHIFT-DOWN ARROW
+
+  KEY  ('H', 'O', 0x36),  // HOLD
+  KEY  ('E', 'X', 0xB2),  // EXECUTE
+  KEY  ('A', 'T', 0xB6),  // ATTN
+
+  KEY  ('C', 'A', 0x96),  // CMD+ATTN
+  KEY  ('C', 'P', 0x91),  // CMD+PLUS
+  KEY  ('C', 'M', 0x93),  // CMD+MINUS
+  KEY  ('C', 'S', 0x95),  // CMD+STAR (multiply)
+
+  DELAY('D', '1', 100),   // DELAY 1
+  DELAY('D', '2', 200),   // DELAY 2
+  DELAY('D', '3', 300),   // DELAY 3
+  DELAY('D', '4', 400),   // DELAY 4
+  DELAY('D', '5', 500),   // DELAY 5
+  DELAY('D', '6', 600),   // DELAY 6
+  DELAY('D', '7', 700),   // DELAY 7
+  DELAY('D', '8', 800),   // DELAY 8
+  DELAY('D', '9', 900),   // DELAY 9
+
+  MODE ('E', '0', EXECUTE_ON_CRLF, 0),  // turn OFF CRLF interpretation
+  MODE ('E', '1', EXECUTE_ON_CRLF, 1),  // turn ON CRLF interpretation (default)
+
+  MODE ('U', '0', UTF8, 0),             // turn OFF UTF-8 decoding (bytes above 127 are ignored)
+  MODE ('U', '1', UTF8, 1),             // turn ON UTF-8 decoding of APL glyphs (default)
+
+  MODE ('F', 'N', FLOW_CONTROL, KBD_FLOW_NONE),      // no flow control (default)
+  MODE ('F', 'X', FLOW_CONTROL, KBD_FLOW_XON_XOFF),  // XON/XOFF flow control
+  MODE ('F', 'H', FLOW_CONTROL, KBD_FLOW_RTS_CTS),   // RTS/CTS flow control
+
+  TIMING('T', 'S', SETUP_US),           // ^TSxx^ data lines setup time before the strobe, xx microseconds
+  TIMING('T', 'W', STROBE_US),          // ^TWxx^ strobe width
+  TIMING('T', 'H', HOLD_US),            // ^THxx^ data lines hold time after the strobe
+  TIMING('T', 'G', GAP_US),             // ^TGxx^ gap between the strobes of two keys
+};
+
+#undef KEY
+#undef DELAY
+#undef MODE
+#undef TIMING
+
+static const size_t PARSE_KEY_COUNT = sizeof(parse_keys) / sizeof(*parse_keys);
+static const uint8_t NO_PARSE_KEY   = 0xFF;
+
+static_assert(PARSE_KEY_COUNT < NO_PARSE_KEY, "too many parse keys");
+
+// ----- Compile time perfect hash -----
+
+static constexpr uint8_t hash_of(size_t i)
+{
+  return kbd_parse_key_hash(parse_keys[i].name[0], parse_keys[i].name[1]);
+}
+
+// Index of the first parse key falling in slot, starting the search at i
+static constexpr uint8_t first_in_slot(uint8_t slot, size_t i = 0)
+{
+  return (i >= PARSE_KEY_COUNT) ? NO_PARSE_KEY : ((hash_of(i) == slot) ? (uint8_t) i : first_in_slot(slot, i + 1));
+}
+
+// The hash is perfect when every parse key is the first (and then only) one of its slot
+static constexpr bool perfect_hash(size_t i = 0)
+{
+  return (i >= PARSE_KEY_COUNT) || ((first_in_slot(hash_of(i)) == i) && perfect_hash(i + 1));
+}
+
+static_assert(perfect_hash(), "two parse keys share the same hash slot, adjust kbd_parse_key_hash()");
+
+struct SlotTable {
+  uint8_t index[KBD_PARSE_KEY_SLOTS];
+};
+
+template <size_t... S>
+static constexpr SlotTable slot_table(KbdIndexList<S...>)
+{
+  return SlotTable {{ first_in_slot(S)... }};
+}
+
+static constexpr SlotTable slots KBD_PROGMEM = slot_table(KbdMakeIndexList<KBD_PARSE_KEY_SLOTS>::type());
+
+bool
+kbd_find_parse_key(char c0, char c1, KbdParseKey & parse_key)
+{
+  const uint8_t i = kbd_read(&slots.index[kbd_parse_key_hash(c0, c1)]);
+
+  if (i == NO_PARSE_KEY) return false;
+
+  parse_key = kbd_read(&parse_keys[i]);
+  return (parse_key.name[0] == c0) && (parse_key.name[1] == c1);
+}
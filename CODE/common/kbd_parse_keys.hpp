@@ -0,0 +1,58 @@
+// Registry of the "^XX^" parse keys.
+//
+// Every parse key is described once, in the table of kbd_parse_keys.cpp, by its
+// two characters and the action it triggers.  The table is indexed at compile
+// time by a perfect hash of the two characters, so finding a parse key costs one
+// hash and one compare no matter how many keys are registered.  A new key that
+// would collide with an existing one is refused by a static_assert; change the
+// hash multiplier if that ever happens.
+
+#pragma once
+
+#include <stdint.h>
+
+#include "kbd_events.hpp"
+#include "kbd_keys.hpp"
+
+enum class KbdAction : uint8_t {
+  NONE,
+  KEY,       // press the KbdKey in arg
+  DELAY,     // wait arg milliseconds
+  SET_MODE,  // set a KbdMode, see kbd_mode_arg()
+  TIMING     // set the emitter timing given after the 2 characters (^TS20^), arg is the KbdEventType to emit
+};
+
+enum class KbdMode : uint8_t {
+  EXECUTE_ON_CRLF,
+  UTF8,
+  FLOW_CONTROL  // value: KBD_FLOW_xxx, applied by the firmware to its serial input
+};
+
+// Flow control of the serial input, selected by ^FN^ ^FX^ ^FH^.  The translator only
+// checks the value: the firmwares look for the MODE event and set up their UART.
+static const uint8_t KBD_FLOW_NONE     = 0;
+static const uint8_t KBD_FLOW_XON_XOFF = 1;  // software: XOFF (DC3) when the receive buffer fills up, XON (DC1) once drained
+static const uint8_t KBD_FLOW_RTS_CTS  = 2;  // hardware: RTS released when the receive buffer fills up (ESP32 only)
+static const uint8_t KBD_FLOW_COUNT    = 3;
+
+struct KbdParseKey {
+  char      name[2];
+  KbdAction action;
+  uint16_t  arg;
+};
+
+constexpr uint16_t kbd_mode_arg(KbdMode mode, uint8_t value) { return (uint16_t) ((((uint8_t) mode) << 8) | value); }
+
+constexpr KbdMode  kbd_mode_arg_mode (uint16_t arg) { return (KbdMode) (arg >> 8); }
+constexpr uint8_t  kbd_mode_arg_value(uint16_t arg) { return (uint8_t) (arg & 0xFF); }
+
+static const uint8_t KBD_PARSE_KEY_SLOTS = 128;  // power of 2
+
+constexpr uint8_t kbd_parse_key_hash(char c0, char c1)
+{
+  return (uint8_t) ((((uint8_t) c0) + 21 * ((uint8_t) c1)) & (KBD_PARSE_KEY_SLOTS - 1));
+}
+
+// Copies the parse key named c0 c1 (the table may be in flash, see kbd_progmem.hpp),
+// returns false when there is none (^XX comment^).
+bool kbd_find_parse_key(char c0, char c1, KbdParseKey & parse_key);
@@ -0,0 +1,75 @@
+// Keyboard profiles: everything the translation core needs to know about one
+// IBM machine type.
+//
+// A profile bundles the ASCII scan code table, the compositions, the APL glyph
+// table, the HID keyboard table, the parse key set, the EXECUTE key and the key
+// timing of a machine.
+// The parity rule of the machine is applied when its tables are generated at
+// compile time (kbd_key() for the 5110, see kbd_keys.hpp), so nothing is
+// computed per key at run time.  The translator and the emitter are given a
+// profile when constructed, the IBM 5110 one by default.  There is no other
+// profile yet: the IBM 5100 one is to come with its tables, transcribed from
+// its MIM, and a way to select it with them.
+//
+// Profiles are plain constant data defined in kbd_profiles.cpp.
+// The tables a profile points to are KBD_PROGMEM (in flash on the Nano), and
+// must be read with kbd_read(), see kbd_progmem.hpp.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "kbd_hid.hpp"
+#include "kbd_keys.hpp"
+#include "kbd_parse_keys.hpp"
+#include "kbd_progmem.hpp"
+
+// Longest sequence of keys a composed character expands to.
+static const uint8_t KBD_MAX_COMPOSITION_LENGTH = 3;
+
+// A character with no key of its own, typed as a short sequence of keys instead:
+// an overstrike (key, backspace, key) or the key of a substitute character.
+struct KbdComposition {
+  uint16_t code_point;
+  uint8_t  length;
+  KbdKey   keys[KBD_MAX_COMPOSITION_LENGTH];
+};
+
+// Timing of one key press, in microseconds:
+//
+//   data lines    ====X=========== key =================X======= next key ...
+//   STROBE (low)  ----|<setup>|____ strobe ____|<hold>|<setup>|____
+//                                              |<---- gap ---->|
+//
+// The data lines are held hold_us after the strobe is released, then those of the
+// next key are set up, so the setup time runs within the gap.  The next strobe comes
+// after the longest of gap_us and hold_us + setup_us.
+struct KbdTiming {
+  uint16_t setup_us;
+  uint16_t strobe_us;
+  uint16_t hold_us;
+  uint16_t gap_us;
+};
+
+// The key of an APL (or math) glyph received as UTF-8.
+struct KbdAplKey {
+  uint16_t code_point;
+  KbdKey   key;
+};
+
+struct KbdProfile {
+  const char           * name;
+  const KbdKey         * ascii_keys;      // 256 entries, indexed by the input byte
+  const KbdComposition * compositions;    // referenced by the composed keys of the tables
+  const KbdAplKey      * apl_keys;        // sorted by code point
+  uint8_t                apl_key_count;
+  const KbdKey         * hid_keys;        // KBD_HID_KEY_COUNT entries, see kbd_hid.hpp
+  KbdKey                 execute_key;     // has some special handling (CR / LF, ^E0^)
+  KbdTiming              timing;          // default timing, changed at run time by ^TSxx^ ^TWxx^ ^THxx^ ^TGxx^
+
+  // Copies the parse key named c0 c1, returns false when there is none
+  bool (* find_parse_key)(char c0, char c1, KbdParseKey & parse_key);
+};
+
+extern const KbdProfile kbd_profile_5110;
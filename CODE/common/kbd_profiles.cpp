@@ -0,0 +1,485 @@
+// Keyboard profiles (IBM 5110 only for now).  See kbd_profile.hpp.
+
+#include "kbd_profile.hpp"
+
+// Scan code for the EXECUTE key has some special handling, so it is given
+// its own specific definition.
+static const uint8_t KEY_EXECUTE = 0xB2;
+
+// The table below is specific to the IBM 5110 scan codes.
+// A similar table could be prepared for the IBM 5100, using the hex values in the IBM 5100 MIM,
+// and registered as a second profile (see profiles at the end of this file).
+//
+// NOTE: To support APL keys, we'll need to define uses of the Extended ASCII values above 128.  Or we could use "parsed_keys",
+// but then a special terminal software will be need to make typing those parsed_keys easier.
+static constexpr uint8_t ascii_to_5110_scan_codes[] = {
+// These hex values are the scancodes used by the IBM 5110
+// keyboard, as indicated in the "NO-SHIFT" row of the
+// MIM manual (page 54, 250 KEY CODES, section 2-36).
+0x00  , //  0   00  NUL        
+0xDF  , //  1   01  SOH    ^A   --> UP ARROW
+0x91  , //  2   02  STX    ^B   --> CMD+PLUS 
+0x00  , //  3   03  ETX    ^C 
+0x00  , //  4   04  EOT    ^D   
+0x00  , //  5   05  ENQ    ^E   
+0x00  , //  6   06  ACK    ^F   
+0x93  , //  7   07  BEL    ^G  --> CMD-MINUS 
+0x34  , //  8   08  BS     ^H  --> LEFT ARROW (like backspace)   
+0x00  , //  9   09  HT     ^I   
+0x00  , //  10  0A  LF     ^J   (see lf_as_execute)
+0x00  , //  11  0B  VT     ^K   
+0x36  , //  12  0C  FF     ^L   --> HOLD  
+0xB2  , //  13  0D  CR     ^M    EXECUTE  (the Ardunino environment translated ENTER as CARRIAGE RETURN 13)
+0x00  , //  14  0E  SO     ^N
+0x34  , //  15  0F  SI     ^O  --> LEFT ARROW
+0xB4  , //  16  10  DLE    ^P  --> RIGHT ARROW
+0x00  , //  17  11  DC1    ^Q 
+0x96  , //  18  12  DC2    ^R  --> CMD-ATTN
+0x00  , //  19  13  DC3    ^S 
+0x95  , //  20  14  DC4    ^T  --> CMD-STAR 
+0x00  , //  21  15  NAK    ^U 
+0x00  , //  22  16  SYN    ^V 
+0x00  , //  23  17  ETB    ^W 
+0x00  , //  24  18  CAN    ^X 
+0x00  , //  25  19  EM     ^Y 
+0x4F  , //  26  1A  SUB    ^Z --> DOWN ARROW
+0xB6  , //  27  1B  ESC       --> ATTN    
+0x00  , //  28  1C  FS        
+0x00  , //  29  1D  GS        
+0x00  , //  30  1E  RS        
+0x00  , //  31  1F  US        
+0x39  , //  32  20  space       
+0x00  , //  33  21  !   composition of ' backspace .  (see compositions below)
+0x4C  , //  34  22  "   SHIFT+1   
+0x30  , //  35  23  #       
+0x4B  , //  36  24  $       
+0x00  , //  37  25  %       
+0x4A  , //  38  26  &   SHIFT+$   
+0xFA  , //  39  27  '   SHIFT+K   
+0x3A  , //  40  28  (       
+0xBA  , //  41  29  )       
+0x9D  , //  42  2A  *   KEYPAD *    
+0x99  , //  43  2B  +   KEYPAD +    
+0xF9  , //  44  2C  ,       
+0x9B  , //  45  2D  -   KEYPAD -    
+0x89  , //  46  2E  .       
+0x00  , //  47  2F  /   no key (KEYPAD divide, scan code still to be read from the MIM)
+0x8F  , //  48  30  0   0x8E  ^ 
+0x4D  , //  49  31  1   0x4C  " 
+0x0F  , //  50  32  2   0x0E  - 
+0xCF  , //  51  33  3   0xCE    
+0xAF  , //  52  34  4   0xAE  <=  
+0x2F  , //  53  35  5   0x2E    
+0xEF  , //  54  36  6   0xEE  >=  
+0x6F  , //  55  37  7   0x6E  \    backslash
+0x7F  , //  56  38  8   0x7E  not equal !=  
+0xFF  , //  57  39  9   0xFE  v  (not letter-V) 
+0x88  , //  58  3A  :   SHIFT+.   
+0xF8  , //  59  3B  ;   SHIFT+,   
+0xCE  , //  60  3C  <       
+0x32  , //  61  3D  =       
+0x6E  , //  62  3E  >       
+0x0C  , //  63  3F  ?   SHIFT+Q   
+0x70  , //  64  40  @   SHIFT+=   
+0x0B  , //  65  41  A   0x0C  ? 
+0xE9  , //  66  42  B   0xE8  : 
+0xA9  , //  67  43  C       
+0xAB  , //  68  44  D       
+0xAD  , //  69  45  E       
+0x2B  , //  70  46  F       
+0xEB  , //  71  47  G       
+0x6B  , //  72  48  H       
+0xFD  , //  73  49  I       
+0x7B  , //  74  4A  J       
+0xFB  , //  75  4B  K       
+0x8B  , //  76  4C  L       
+0x79  , //  77  4D  M       
+0x69  , //  78  4E  N       
+0x8D  , //  79  4F  O       
+0x3D  , //  80  50  P       
+0x0D  , //  81  51  Q   0C  ? 
+0x2D  , //  82  52  R   2C    
+0xCB  , //  83  53  S       
+0xED  , //  84  54  T       
+0x7D  , //  85  55  U       
+0x29  , //  86  56  V       
+0xCD  , //  87  57  W       
+0xC9  , //  88  58  X       
+0x6D  , //  89  59  Y       
+0x09  , //  90  5A  Z       
+0x00  , //  91  5B  [   (see compositions below)
+0x00  , //  92  5C  \   BACKSLASH
+0x00  , //  93  5D  ]   (see compositions below)
+0x00  , //  94  5E  ^       
+0x00  , //  95  5F  _       
+0x00  , //  96  60  ` start single quote |
+0x0B  , //  97  61  a       
+0xE9  , //  98  62  b       
+0xA9  , //  99  63  c       
+0xAB  , //  100 64  d       
+0xAD  , //  101 65  e       
+0x2B  , //  102 66  f       
+0xEB  , //  103 67  g       
+0x6B  , //  104 68  h       
+0xFD  , //  105 69  i       
+0x7B  , //  106 6A  j       
+0xFB  , //  107 6B  k       
+0x8B  , //  108 6C  l       
+0x79  , //  109 6D  m       
+0x69  , //  110 6E  n       
+0x8D  , //  111 6F  o       
+0x3D  , //  112 70  p       
+0x0D  , //  113 71  q       
+0x2D  , //  114 72  r       
+0xCB  , //  115 73  s       
+0xED  , //  116 74  t       
+0x7D  , //  117 75  u       
+0x29  , //  118 76  v       
+0xCD  , //  119 77  w       
+0xC9  , //  120 78  x       
+0x6D  , //  121 79  y       
+0x09  , //  122 7A  z       
+0x00  , //  123 7B  {       
+0x00  , //  124 7C  |       
+0x00  , //  125 7D  }       
+0x96  , //  126 7E  ~    -->   CMD+ATTN    
+0x34  , //  127 7F  DEL       
+0x00  , //  128 80           
+0x00  , //  129 81           
+0x00  , //  130 82           
+0x00  , //  131 83           
+0x00  , //  132 84           
+0x00  , //  133 85           
+0x00  , //  134 86           
+0x00  , //  135 87           
+0x00  , //  136 88           
+0x00  , //  137 89           
+0x00  , //  138 8A           
+0x00  , //  139 8B           
+0x00  , //  140 8C           
+0x00  , //  141 8D           
+0x00  , //  142 8E           
+0x00  , //  143 8F           
+0x00  , //  144 90           
+0x00  , //  145 91           
+0x00  , //  146 92           
+0x00  , //  147 93           
+0x00  , //  148 94           
+0x00  , //  149 95           
+0x00  , //  150 96           
+0x00  , //  151 97           
+0x00  , //  152 98           
+0x00  , //  153 99           
+0x00  , //  154 9A           
+0x00  , //  155 9B           
+0x00  , //  156 9C           
+0x00  , //  157 9D           
+0x00  , //  158 9E           
+0x00  , //  159 9F           
+0x00  , //  160 A0            
+0x00  , //  161 A1  ¡         
+0x00  , //  162 A2  ¢         
+0x00  , //  163 A3  £         
+0x00  , //  164 A4  ¤         
+0x00  , //  165 A5  ¥         
+0x00  , //  166 A6  ¦         
+0x00  , //  167 A7  §         
+0x00  , //  168 A8  ¨         
+0x00  , //  169 A9  ©         
+0x00  , //  170 AA  ª         
+0x00  , //  171 AB  «         
+0x00  , //  172 AC  ¬         
+0x00  , //  173 AD  ­         
+0x00  , //  174 AE  ®         
+0x00  , //  175 AF  ¯         
+0x00  , //  176 B0  °         
+0x00  , //  177 B1  ±         
+0x00  , //  178 B2  ²         
+0x00  , //  179 B3  ³         
+0x00  , //  180 B4  ´         
+0x00  , //  181 B5  µ         
+0x00  , //  182 B6  ¶         
+0x00  , //  183 B7  ·         
+0x00  , //  184 B8  ¸         
+0x00  , //  185 B9  ¹         
+0x00  , //  186 BA  º         
+0x00  , //  187 BB  »         
+0x00  , //  188 BC  ¼         
+0x00  , //  189 BD  ½         
+0x00  , //  190 BE  ¾         
+0x00  , //  191 BF  ¿         
+0x00  , //  192 C0  À         
+0x00  , //  193 C1  Á         
+0x00  , //  194 C2  Â         
+0x00  , //  195 C3  Ã         
+0x00  , //  196 C4  Ä         
+0x00  , //  197 C5  Å         
+0x00  , //  198 C6  Æ         
+0x00  , //  199 C7  Ç         
+0x00  , //  200 C8  È         
+0x00  , //  201 C9  É         
+0x00  , //  202 CA  Ê         
+0x00  , //  203 CB  Ë         
+0x00  , //  204 CC  Ì         
+0x00  , //  205 CD  Í         
+0x00  , //  206 CE  Î         
+0x00  , //  207 CF  Ï         
+0x00  , //  208 D0  Ð         
+0x00  , //  209 D1  Ñ         
+0x00  , //  210 D2  Ò         
+0x00  , //  211 D3  Ó         
+0x00  , //  212 D4  Ô         
+0x00  , //  213 D5  Õ         
+0x00  , //  214 D6  Ö         
+0x00  , //  215 D7  ×         
+0x00  , //  216 D8  Ø         
+0x00  , //  217 D9  Ù         
+0x00  , //  218 DA  Ú         
+0x00  , //  219 DB  Û         
+0x00  , //  220 DC  Ü         
+0x00  , //  221 DD  Ý         
+0x00  , //  222 DE  Þ         
+0x00  , //  223 DF  ß         
+0x00  , //  224 E0  à         
+0x00  , //  225 E1  á         
+0x00  , //  226 E2  â         
+0x00  , //  227 E3  ã         
+0x00  , //  228 E4  ä         
+0x00  , //  229 E5  å         
+0x00  , //  230 E6  æ         
+0x00  , //  231 E7  ç         
+0x00  , //  232 E8  è         
+0x00  , //  233 E9  é         
+0x00  , //  234 EA  ê         
+0x00  , //  235 EB  ë         
+0x00  , //  236 EC  ì         
+0x00  , //  237 ED  í         
+0x00  , //  238 EE  î         
+0x00  , //  239 EF  ï         
+0x00  , //  240 F0  ð         
+0x00  , //  241 F1  ñ         
+0x00  , //  242 F2  ò         
+0x00  , //  243 F3  ó         
+0x00  , //  244 F4  ô         
+0x00  , //  245 F5  õ         
+0x00  , //  246 F6  ö         
+0x00  , //  247 F7  ÷         
+0x00  , //  248 F8  ø         
+0x00  , //  249 F9  ù         
+0x00  , //  250 FA  ú         
+0x00  , //  251 FB  û         
+0x00  , //  252 FC  ü         
+0x00  , //  253 FD  ý         
+0x00  , //  254 FE  þ         
+0x00  , //  255 FF  ÿ       
+};
+
+// No size is given to the list above on purpose: a missing or extra line shifts every entry after it,
+// which would otherwise go unnoticed.  (Beware of comments ending with a backslash: the next line becomes
+// part of the comment.)
+static_assert(sizeof(ascii_to_5110_scan_codes) == 256, "ascii_to_5110 must have exactly 256 entries");
+
+// Characters the 5110 has no single key for, typed as a short sequence of keys instead: an
+// overstrike (key, backspace, key) or the key of a substitute character.  ASCII entries only
+// apply to characters left at 0x00 in ascii_to_5110_scan_codes; the others are APL glyphs
+// referenced from apl_keys below.
+#define OVERSTRIKE(code_point, scan_code_1, scan_code_2) \
+  { code_point, 3, { kbd_key(scan_code_1), kbd_key(0x34), kbd_key(scan_code_2) } }  // 0x34 = LEFT ARROW (backspace)
+
+static constexpr KbdComposition compositions[] KBD_PROGMEM = {
+  OVERSTRIKE('!',    0xFA, 0x89),                      // '   .
+  { '[', 1, { kbd_key(0x3A) } },                       // (   BASIC only knows parentheses for array subscripts
+  { ']', 1, { kbd_key(0xBA) } },                       // )
+
+  OVERSTRIKE(0x233D, 0x8C, 0x78),                      // ⌽   ○ |
+  OVERSTRIKE(0x234B, 0x6A, 0x78),                      // ⍋   ∆ |
+  OVERSTRIKE(0x234E, 0xE8, 0x7A),                      // ⍎   ⊥ ∘
+  OVERSTRIKE(0x2352, 0xEA, 0x78),                      // ⍒   ∇ |
+  OVERSTRIKE(0x2355, 0x68, 0x7A),                      // ⍕   ⊤ ∘
+  OVERSTRIKE(0x235D, 0xA8, 0x7A),                      // ⍝   ∩ ∘
+  OVERSTRIKE(0x235E, 0x8A, 0xFA),                      // ⍞   ⎕ '
+  OVERSTRIKE(0x235F, 0x8C, 0x3C),                      // ⍟   ○ ⋆
+  OVERSTRIKE(0x236B, 0xEA, 0xEC),                      // ⍫   ∇ ∼
+  OVERSTRIKE(0x2371, 0xFE, 0xEC),                      // ⍱   ∨ ∼
+  OVERSTRIKE(0x2372, 0x8E, 0xEC),                      // ⍲   ∧ ∼
+  OVERSTRIKE(0x2296, 0x8C, 0x9B),                      // ⊖   ○ -
+};
+
+#undef OVERSTRIKE
+
+static const uint8_t COMPOSITION_COUNT = sizeof(compositions) / sizeof(*compositions);
+
+static constexpr bool compositions_valid(size_t i = 0, uint8_t k = 0)
+{
+  return (i >= COMPOSITION_COUNT) ||
+         ((k >= compositions[i].length) ? ((compositions[i].length <= KBD_MAX_COMPOSITION_LENGTH) && compositions_valid(i + 1, 0))
+                                        : ((compositions[i].keys[k] != KBD_KEY_NONE) && compositions_valid(i, k + 1)));
+}
+
+static_assert(compositions_valid(), "bad key in compositions");
+
+// The composed key of a code point, KBD_KEY_NONE if it has no composition
+static constexpr KbdKey composition_of(uint16_t code_point, uint8_t i = 0)
+{
+  return (i >= COMPOSITION_COUNT)                    ? KBD_KEY_NONE :
+         (compositions[i].code_point == code_point) ? kbd_composed_key(i) : composition_of(code_point, i + 1);
+}
+
+// The key of an ASCII character, or the reference to its composition
+static constexpr KbdKey ascii_key(size_t ch)
+{
+  return (ascii_to_5110_scan_codes[ch] != 0x00) ? kbd_key(ascii_to_5110_scan_codes[ch]) :
+         (ch < 0x80)                            ? composition_of(ch) : KBD_KEY_NONE;
+}
+
+template <size_t... I>
+static constexpr KbdKeyTable<256> ascii_key_table(KbdIndexList<I...>)
+{
+  return KbdKeyTable<256> {{ ascii_key(I)... }};
+}
+
+static constexpr KbdKeyTable<256> ascii_to_5110 KBD_PROGMEM = ascii_key_table(KbdMakeIndexList<256>::type());
+
+static_assert(kbd_key_table_valid(ascii_to_5110), "bad parity in ascii_to_5110");
+static_assert(kbd_key_code(ascii_to_5110['\r']) == KEY_EXECUTE, "ascii_to_5110 is misaligned");
+static_assert(kbd_key_code(ascii_to_5110['8'])  == 0x7F, "ascii_to_5110 is misaligned");
+static_assert(kbd_key_code(ascii_to_5110['A'])  == 0x0B, "ascii_to_5110 is misaligned");
+static_assert(kbd_key_code(ascii_to_5110['a'])  == 0x0B, "ascii_to_5110 is misaligned");
+static_assert(kbd_key_code(ascii_to_5110[0x7F]) == 0x34, "ascii_to_5110 is misaligned");
+static_assert(kbd_key_is_composed(ascii_to_5110['!']), "ascii_to_5110 is missing its compositions");
+
+// HID keyboards (see kbd_hid.hpp): the keys with no ASCII character of their own, by layer
+// (0x00: go through the ASCII table).  SHIFT gives the scan code with bit 0 cleared, as on the
+// SHIFT row of the 5110 keyboard.
+static constexpr uint8_t hid_scan_code_5110(uint8_t layer, uint8_t usage)
+{
+  return (usage == KBD_HID_RIGHT) ? 0xB4 :
+         (usage == KBD_HID_LEFT)  ? 0x34 :
+         (usage == KBD_HID_UP)    ? ((layer == KBD_HID_SHIFT_LAYER) ? 0xDE : 0xDF) :
+         (usage == KBD_HID_DOWN)  ? ((layer == KBD_HID_SHIFT_LAYER) ? 0x4E : 0x4F) :
+         (usage == KBD_HID_PAUSE) ? 0x36 :  // HOLD
+         (layer != KBD_HID_CTRL_LAYER) ? 0x00 :
+         (usage == KBD_HID_ESCAPE)                                   ? 0x96 :  // CMD-ATTN
+         ((usage == KBD_HID_EQUAL) || (usage == KBD_HID_KP_PLUS))    ? 0x91 :  // CMD+PLUS
+         ((usage == KBD_HID_MINUS) || (usage == KBD_HID_KP_MINUS))   ? 0x93 :  // CMD-MINUS
+         (usage == KBD_HID_KP_STAR)                                  ? 0x95 :  // CMD-STAR
+         0x00;
+}
+
+// The key of a usage in a layer.  CTRL+letter is the control code (CTRL+Z is the DOWN ARROW, like
+// on a serial terminal), CTRL with any other key is the key alone.
+static constexpr KbdKey hid_key_5110(uint8_t layer, uint8_t usage)
+{
+  return (hid_scan_code_5110(layer, usage) != 0x00) ? kbd_key(hid_scan_code_5110(layer, usage)) :
+         (layer != KBD_HID_CTRL_LAYER)              ? ascii_key((uint8_t) kbd_hid_char(usage, layer == KBD_HID_SHIFT_LAYER)) :
+         kbd_hid_is_letter(usage)                   ? ascii_key((uint8_t) kbd_hid_ctrl_char(usage)) :
+                                                      hid_key_5110(KBD_HID_PLAIN_LAYER, usage);
+}
+
+template <size_t... I>
+static constexpr KbdKeyTable<KBD_HID_KEY_COUNT> hid_key_table(KbdIndexList<I...>)
+{
+  return KbdKeyTable<KBD_HID_KEY_COUNT> {{ hid_key_5110(I / KBD_HID_USAGE_COUNT, I % KBD_HID_USAGE_COUNT)... }};
+}
+
+static constexpr KbdKeyTable<KBD_HID_KEY_COUNT> hid_to_5110 KBD_PROGMEM = hid_key_table(KbdMakeIndexList<KBD_HID_KEY_COUNT>::type());
+
+static_assert(kbd_key_table_valid(hid_to_5110), "bad parity in hid_to_5110");
+static_assert(hid_to_5110[kbd_hid_index(KBD_HID_PLAIN_LAYER, KBD_HID_A)]       == ascii_to_5110['a'], "hid_to_5110 is misaligned");
+static_assert(hid_to_5110[kbd_hid_index(KBD_HID_SHIFT_LAYER, KBD_HID_1)]       == ascii_to_5110['!'], "hid_to_5110 is misaligned");
+static_assert(hid_to_5110[kbd_hid_index(KBD_HID_PLAIN_LAYER, KBD_HID_SLASH)]   == ascii_to_5110['/'], "hid_to_5110 is misaligned");
+static_assert(hid_to_5110[kbd_hid_index(KBD_HID_PLAIN_LAYER, KBD_HID_ENTER)]   == kbd_key(KEY_EXECUTE), "hid_to_5110 is misaligned");
+static_assert(hid_to_5110[kbd_hid_index(KBD_HID_PLAIN_LAYER, KBD_HID_KP_ENTER)] == kbd_key(KEY_EXECUTE), "hid_to_5110 is misaligned");
+static_assert(hid_to_5110[kbd_hid_index(KBD_HID_PLAIN_LAYER, KBD_HID_KP_DOT)]  == ascii_to_5110['.'], "hid_to_5110 is misaligned");
+static_assert(hid_to_5110[kbd_hid_index(KBD_HID_CTRL_LAYER,  KBD_HID_Z)]       == ascii_to_5110[26], "hid_to_5110 is misaligned");
+static_assert(hid_to_5110[kbd_hid_index(KBD_HID_CTRL_LAYER,  KBD_HID_ESCAPE)]  == ascii_to_5110['~'], "hid_to_5110 is misaligned");
+static_assert(hid_to_5110[kbd_hid_index(KBD_HID_PLAIN_LAYER, KBD_HID_F1)]      == KBD_KEY_NONE, "hid_to_5110 is misaligned");
+
+// APL and math glyphs received as UTF-8, sorted by code point.
+//
+// The shifted codes follow the SHIFT row of the 5110 keyboard: SHIFT gives the scan code of the
+// key with bit 0 cleared (K 0xFB -> ' 0xFA, Q 0x0D -> ? 0x0C, 1 0x4D -> " 0x4C, ...), and the APL
+// glyph of each key is the one of the standard APL typewriter layout (SHIFT-A is alpha, SHIFT-9 is
+// OR, etc).  Glyphs with no key of their own are overstrikes, see compositions above.
+#define APL(code_point, scan_code)  { code_point, kbd_key(scan_code) }
+#define OVER(code_point)            { code_point, composition_of(code_point) }
+
+static constexpr KbdAplKey apl_keys[] KBD_PROGMEM = {
+  APL (0x00A8, 0x4C),  // ¨   SHIFT+1
+  APL (0x00AF, 0x0E),  // ¯   SHIFT+2  (high minus)
+  APL (0x00D7, 0x9D),  // ×   KEYPAD *
+  APL (0x2191, 0x6C),  // ↑   SHIFT+Y
+  APL (0x2193, 0x7C),  // ↓   SHIFT+U
+  APL (0x2206, 0x6A),  // ∆   SHIFT+H
+  APL (0x2207, 0xEA),  // ∇   SHIFT+G
+  APL (0x2208, 0xAC),  // ∈   SHIFT+E
+  APL (0x220A, 0xAC),  // ∊   SHIFT+E
+  APL (0x2212, 0x9B),  // −   KEYPAD -
+  APL (0x2218, 0x7A),  // ∘   SHIFT+J
+  APL (0x2227, 0x8E),  // ∧   SHIFT+0
+  APL (0x2228, 0xFE),  // ∨   SHIFT+9
+  APL (0x2229, 0xA8),  // ∩   SHIFT+C
+  APL (0x222A, 0x28),  // ∪   SHIFT+V
+  APL (0x223C, 0xEC),  // ∼   SHIFT+T
+  APL (0x2260, 0x7E),  // ≠   SHIFT+8
+  APL (0x2264, 0xAE),  // ≤   SHIFT+4
+  APL (0x2265, 0xEE),  // ≥   SHIFT+6
+  APL (0x2282, 0x08),  // ⊂   SHIFT+Z
+  APL (0x2283, 0xC8),  // ⊃   SHIFT+X
+  OVER(0x2296),        // ⊖
+  APL (0x22A4, 0x68),  // ⊤   SHIFT+N
+  APL (0x22A5, 0xE8),  // ⊥   SHIFT+B
+  APL (0x22C6, 0x3C),  // ⋆   SHIFT+P
+  APL (0x2308, 0xCA),  // ⌈   SHIFT+S
+  APL (0x230A, 0xAA),  // ⌊   SHIFT+D
+  OVER(0x233D),        // ⌽
+  OVER(0x234B),        // ⍋
+  OVER(0x234E),        // ⍎
+  OVER(0x2352),        // ⍒
+  OVER(0x2355),        // ⍕
+  OVER(0x235D),        // ⍝
+  OVER(0x235E),        // ⍞
+  OVER(0x235F),        // ⍟
+  OVER(0x236B),        // ⍫
+  OVER(0x2371),        // ⍱
+  OVER(0x2372),        // ⍲
+  APL (0x2373, 0xFC),  // ⍳   SHIFT+I
+  APL (0x2374, 0x2C),  // ⍴   SHIFT+R
+  APL (0x2375, 0xCC),  // ⍵   SHIFT+W
+  APL (0x237A, 0x0A),  // ⍺   SHIFT+A
+  APL (0x2395, 0x8A),  // ⎕   SHIFT+L
+  APL (0x25CB, 0x8C),  // ○   SHIFT+O
+};
+
+#undef APL
+#undef OVER
+
+static const uint8_t APL_KEY_COUNT = sizeof(apl_keys) / sizeof(*apl_keys);
+
+static constexpr bool apl_keys_valid(size_t i = 0)
+{
+  return (i >= APL_KEY_COUNT) ||
+         ((apl_keys[i].key != KBD_KEY_NONE) &&
+          (kbd_key_is_composed(apl_keys[i].key) || (kbd_key_parity(apl_keys[i].key) == kbd_parity(kbd_key_code(apl_keys[i].key)))) &&
+          ((i == 0) || (apl_keys[i - 1].code_point < apl_keys[i].code_point)) &&
+          apl_keys_valid(i + 1));
+}
+
+static_assert(apl_keys_valid(), "apl_keys must be sorted by code point, and only reference existing compositions");
+
+// ----- Profiles -----
+
+const KbdProfile kbd_profile_5110 = {
+  "IBM 5110",
+  ascii_to_5110.keys,
+  compositions,
+  apl_keys,
+  APL_KEY_COUNT,
+  hid_to_5110.keys,
+  kbd_key(KEY_EXECUTE),
+  // The oscope on the 5110 observed 60ms between repeat keys, but a 10ms strobe works here
+  // (0-4ms did not work).  Setup and gap are close to what the original loop() took, and
+  // the lines are held a little after the strobe, as when the loop released them one by one.
+  { 50, 10000, 10, 50 },
+  kbd_find_parse_key
+};
@@ -0,0 +1,38 @@
+// Constant tables in program memory.
+//
+// On the AVR (Arduino Nano) constant data is copied to SRAM at startup unless
+// it is placed in flash with PROGMEM, and must then be read with the pgm_read
+// functions.  The translation tables (ASCII keys, compositions, APL glyphs,
+// parse keys) are declared KBD_PROGMEM and only ever read through kbd_read(),
+// which is a plain read everywhere else (ESP32 and host builds).
+
+#pragma once
+
+#include <stdint.h>
+
+#if defined(__AVR__)
+
+#include <avr/pgmspace.h>
+
+#define KBD_PROGMEM PROGMEM
+
+template <typename T>
+inline T kbd_read(const T * p)
+{
+  T value;
+  memcpy_P(&value, p, sizeof(T));
+  return value;
+}
+
+inline uint8_t  kbd_read(const uint8_t  * p) { return pgm_read_byte(p); }
+inline uint16_t kbd_read(const uint16_t * p) { return pgm_read_word(p); }
+inline char     kbd_read(const char     * p) { return (char) pgm_read_byte(p); }
+
+#else
+
+#define KBD_PROGMEM
+
+template <typename T>
+inline T kbd_read(const T * p) { return *p; }
+
+#endif
@@ -0,0 +1,247 @@
+// Shared ASCII to IBM 5110 keyboard translation core.  See kbd_translator.hpp.
+
+#include "kbd_translator.hpp"
+
+// Sequence length of an UTF-8 lead byte, by its high nibble (0: continuation byte)
+static const uint8_t utf8_sequence_length[16] KBD_PROGMEM = { 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 2, 2, 3, 4 };
+
+KbdTranslator::KbdTranslator(bool lf_as_execute, const KbdProfile & profile) :
+  profile(&profile),
+  lf_as_execute(lf_as_execute),
+  interpret_crlf_as_execute(true),
+  last_was_cr(false),
+  caps_lock(false),
+  utf8_enabled(true),
+  utf8_remaining(0),
+  utf8_code_point(0),
+  parse_key_mode(false),
+  parse_key_buffer_index(0),
+  parse_key_value(0),
+  parse_key_value_digits(0)
+{
+}
+
+size_t
+KbdTranslator::translate(const uint8_t * in, size_t in_len, KbdEvent * out, size_t out_size, size_t & out_len)
+{
+  size_t i = 0;
+
+  while ((i < in_len) && ((out_size - out_len) >= MAX_EVENTS_PER_BYTE)) {
+    out_len += put(in[i++], &out[out_len]);
+  }
+  return i;
+}
+
+uint8_t
+KbdTranslator::put(uint8_t ch, KbdEvent * out)
+{
+  const bool after_cr = last_was_cr;
+  last_was_cr = false;
+
+  if (parse_key_mode) {
+    if (ch == PARSE_KEY_TOKEN) {
+      // already in PARSE_KEY_MODE, so exit this mode and parse the buffered parse_key
+      parse_key_mode = false;
+      return parse_key_done(out);
+    }
+    if (parse_key_buffer_index < PARSE_KEY_LENGTH) {
+      parse_key_buffer[parse_key_buffer_index++] = ch;
+    }
+    else if (parse_key_value_digits != PARSE_KEY_NO_VALUE) {
+      // Some parse keys take a decimal value after their 2 characters.  Anything else is
+      // ignored, so ^XX comment^ can be used as a comment.
+      const uint8_t digit = ch - '0';
+      if ((digit <= 9) && (parse_key_value <= (0xFFFF - digit) / 10)) {
+        parse_key_value = parse_key_value * 10 + digit;
+        parse_key_value_digits++;
+      }
+      else {
+        parse_key_value_digits = PARSE_KEY_NO_VALUE;
+      }
+    }
+    return 0;
+  }
+
+  if (utf8_enabled) {
+    if (ch >= 0x80) return put_utf8(ch, out);
+    utf8_remaining = 0;  // an ASCII character ends any incomplete sequence
+  }
+
+  KbdKey key;
+
+  if (ch == '\n' && lf_as_execute) {
+    if (after_cr) return 0;  // the EXECUTE was already given by the CR
+    key = profile->execute_key;
+  }
+  else {
+    // index the ASCII table by incoming ASCII byte value, to get the mapped IBM 5110 scan code to use in response
+    key = kbd_read(&profile->ascii_keys[ch]);
+    last_was_cr = (ch == '\r');
+  }
+
+  if (key == KBD_KEY_NONE) {
+    if (ch == PARSE_KEY_TOKEN) {
+      // START/ENTER parse_key mode...
+      parse_key_mode         = true;
+      parse_key_buffer_index = 0;
+      parse_key_buffer[0]    = 0;
+      parse_key_buffer[1]    = 0;
+      parse_key_value        = 0;
+      parse_key_value_digits = 0;
+    }
+    // else could not determine how to interpret the given ASCII data... not an error, just nothing to do.
+    return 0;
+  }
+
+  if ((key == profile->execute_key) && !interpret_crlf_as_execute) {
+    // However we are commanded to issue an EXECUTE, double check whether we are "authorized"
+    // or configured to actually send out EXECUTE commands right now.
+    // (during certain scripted inputs, we may want to disable doing this, so that the scripted
+    // input can maintain its original format for convenience)
+    return 0;
+  }
+
+  return put_key(key, out);
+}
+
+uint8_t
+KbdTranslator::put_hid(uint8_t usage, uint8_t modifiers, KbdEvent * out)
+{
+  if (usage >= KBD_HID_USAGE_COUNT) return 0;
+
+  if (usage == KBD_HID_CAPS_LOCK) {
+    caps_lock = !caps_lock;
+    return 0;
+  }
+
+  if (parse_key_mode) {
+    if (modifiers & KBD_HID_CTRL) return 0;
+
+    const bool shift = ((modifiers & KBD_HID_SHIFT) != 0) != (caps_lock && kbd_hid_is_letter(usage));
+    const char ch    = kbd_hid_char(usage, shift);
+    return (ch != 0) ? put(ch, out) : 0;
+  }
+
+  last_was_cr    = false;
+  utf8_remaining = 0;
+
+  const KbdKey key = kbd_read(&profile->hid_keys[kbd_hid_index(kbd_hid_layer(modifiers), usage)]);
+
+  if (key == KBD_KEY_NONE) {
+    // Starts a parse key, else a key with nothing to do on the IBM machine (F1...)
+    return ((modifiers & KBD_HID_CTRL) == 0) && (kbd_hid_char(usage, (modifiers & KBD_HID_SHIFT) != 0) == PARSE_KEY_TOKEN)
+             ? put(PARSE_KEY_TOKEN, out) : 0;
+  }
+
+  if ((key == profile->execute_key) && !interpret_crlf_as_execute) return 0;
+
+  return put_key(key, out);
+}
+
+uint8_t
+KbdTranslator::put_key(KbdKey key, KbdEvent * out)
+{
+  if (kbd_key_is_composed(key)) return compose(kbd_key_composition(key), out);
+
+  out->type  = KbdEventType::KEY;
+  out->value = key;
+  return 1;
+}
+
+uint8_t
+KbdTranslator::put_utf8(uint8_t ch, KbdEvent * out)
+{
+  if ((ch & 0xC0) == 0x80) {
+    if (utf8_remaining == 0) return 0;  // stray continuation byte
+
+    utf8_code_point = (utf8_code_point << 6) | (ch & 0x3F);
+    if (--utf8_remaining != 0) return 0;
+
+    if (utf8_code_point > 0xFFFF) return 0;  // no APL glyph outside of the BMP
+
+    // binary search of the code point
+    const KbdAplKey * apl_keys = profile->apl_keys;
+    uint8_t           low      = 0;
+    uint8_t           high     = profile->apl_key_count;
+    while (low < high) {
+      const uint8_t middle = (low + high) >> 1;
+      if (kbd_read(&apl_keys[middle].code_point) < utf8_code_point) {
+        low = middle + 1;
+      }
+      else {
+        high = middle;
+      }
+    }
+    if ((low < profile->apl_key_count) && (kbd_read(&apl_keys[low].code_point) == utf8_code_point)) {
+      return put_key(kbd_read(&apl_keys[low].key), out);
+    }
+    return 0;  // a glyph with no 5110 key, ignored like any other untranslatable input
+  }
+
+  const uint8_t length = kbd_read(&utf8_sequence_length[ch >> 4]);
+  utf8_remaining  = length - 1;
+  utf8_code_point = ch & (0x7F >> length);  // payload bits of the lead byte
+  return 0;
+}
+
+uint8_t
+KbdTranslator::compose(uint8_t composition, KbdEvent * out)
+{
+  const KbdComposition c = kbd_read(&profile->compositions[composition]);
+
+  for (uint8_t i = 0; i < c.length; i++) {
+    out[i].type  = KbdEventType::KEY;
+    out[i].value = c.keys[i];
+  }
+  return c.length;
+}
+
+uint8_t
+KbdTranslator::parse_key_done(KbdEvent * out)
+{
+  // NOTE: an unknown parse key is not an error, so parsed_key can be used as comments by just
+  // specifying an invalid code, e.g. ^XX comment^, that won't get translated into any inputs/keys
+  KbdParseKey parse_key;
+  if (!profile->find_parse_key(parse_key_buffer[0], parse_key_buffer[1], parse_key)) return 0;
+
+  switch (parse_key.action) {
+    case KbdAction::KEY:
+      out->type = KbdEventType::KEY;
+      break;
+    case KbdAction::DELAY:
+      out->type = KbdEventType::DELAY;
+      break;
+    case KbdAction::SET_MODE:
+      if (!set_mode(kbd_mode_arg_mode(parse_key.arg), kbd_mode_arg_value(parse_key.arg))) return 0;
+      out->type = KbdEventType::MODE;
+      break;
+    case KbdAction::TIMING:
+      if ((parse_key_value_digits == 0) || (parse_key_value_digits == PARSE_KEY_NO_VALUE)) return 0;
+      out->type  = (KbdEventType) parse_key.arg;
+      out->value = parse_key_value;
+      return 1;
+    default:
+      return 0;
+  }
+  out->value = parse_key.arg;
+  return 1;
+}
+
+bool
+KbdTranslator::set_mode(KbdMode mode, uint8_t value)
+{
+  switch (mode) {
+    case KbdMode::EXECUTE_ON_CRLF:
+      interpret_crlf_as_execute = (value != 0);
+      break;
+    case KbdMode::UTF8:
+      utf8_enabled   = (value != 0);
+      utf8_remaining = 0;
+      break;
+    case KbdMode::FLOW_CONTROL:
+      return value < KBD_FLOW_COUNT;  // nothing to do here, see KBD_FLOW_NONE
+    default:
+      return false;
+  }
+  return true;
+}
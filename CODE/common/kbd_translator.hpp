@@ -0,0 +1,96 @@
+// Shared ASCII to IBM 5110 keyboard translation core.
+//
+// This is the single copy of the logic that used to be duplicated in the
+// loop() of every firmware: ASCII to scan code lookup and the "^..^" parse
+// keys.  The translator is a streaming decoder: it is given whole buffers of
+// input bytes and appends the resulting KbdEvents to a caller provided buffer,
+// for a KbdEmitter to play on the keyboard lines.  Bytes above 127 are decoded
+// as UTF-8, so APL glyphs pasted from a modern editor map to their 5110 keys.
+// All its state lives in the object, so a parse key split across two buffers
+// is handled like any other.  The tables used come from a KbdProfile
+// (kbd_profile.hpp), the IBM 5110 one unless told otherwise.  Keys of a HID
+// keyboard (bluetooth adapter) are translated by put_hid(), without going
+// through ASCII.
+//
+// See the header of 5110KBD.ino for the list of CTRL codes and parse keys.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "kbd_events.hpp"
+#include "kbd_hid.hpp"
+#include "kbd_keys.hpp"
+#include "kbd_parse_keys.hpp"
+#include "kbd_profile.hpp"
+
+class KbdTranslator
+{
+  public:
+    static const uint8_t PARSE_KEY_TOKEN = '^';
+
+    // Most events a single input byte can produce.  translate() stops early rather
+    // than split the events of one byte when the output buffer gets short.
+    static const uint8_t MAX_EVENTS_PER_BYTE = KBD_MAX_COMPOSITION_LENGTH;
+
+    // lf_as_execute: also treat LF (hex 0A) as an EXECUTE, for terminals (like VSCODE)
+    // that send NEWLINE 10 instead of CARRIAGE RETURN 13 for the ENTER key.  A CR
+    // immediately followed by a LF then gives a single EXECUTE.
+    KbdTranslator(bool lf_as_execute = false, const KbdProfile & profile = kbd_profile_5110);
+
+    // Translates up to in_len bytes of in, appending the events to out (out_len is
+    // updated, and never goes over out_size).  Returns the number of input bytes
+    // consumed, which is less than in_len only when out is full: call again with the
+    // rest once it is drained.
+    size_t translate(const uint8_t * in, size_t in_len, KbdEvent * out, size_t out_size, size_t & out_len);
+
+    // Translates a single byte, returning the number of events written to out
+    // (out must have room for MAX_EVENTS_PER_BYTE events).
+    uint8_t put(uint8_t ch, KbdEvent * out);
+
+    // Translates a key pressed on a HID keyboard (bluetooth adapter), with the modifier
+    // byte of its report, in a single lookup of the HID table of the profile (see
+    // kbd_hid.hpp).  Within a parse key, keys are typed as their characters instead, so
+    // ^E0^ works from the keyboard too.  Same return value as put().
+    uint8_t put_hid(uint8_t usage, uint8_t modifiers, KbdEvent * out);
+
+    inline bool in_parse_key() const { return parse_key_mode; }
+
+    inline const KbdProfile & get_profile() const { return *profile; }
+
+  private:
+    static const uint8_t PARSE_KEY_LENGTH = 2;  // by convention, each parse key is 2 characters
+    static const uint8_t PARSE_KEY_NO_VALUE = 0xFF;
+
+    uint8_t        put_key(KbdKey key, KbdEvent * out);
+    uint8_t       put_utf8(uint8_t ch, KbdEvent * out);
+    uint8_t parse_key_done(KbdEvent * out);
+    uint8_t        compose(uint8_t composition, KbdEvent * out);
+    bool          set_mode(KbdMode mode, uint8_t value);  // false: value not valid for mode
+
+    const KbdProfile * profile;
+
+    bool     lf_as_execute;
+
+    // When pasting code or content, sometimes you really want to enter hex 13 or 10,
+    // without it being interpreted as ^M and becoming a press of EXECUTE on the IBM 5110.
+    // ^E0^ can be used to turn off that translation, then later turn it back using ^E1^
+    bool     interpret_crlf_as_execute;
+
+    bool     last_was_cr;     // to give a single EXECUTE for CR LF
+
+    bool     caps_lock;       // of a HID keyboard, only matters to the characters of a parse key
+
+    // Input bytes above 127 are decoded as UTF-8, for the APL glyphs.  ^U0^ / ^U1^ turn
+    // it off / on.
+    bool     utf8_enabled;
+    uint8_t  utf8_remaining;  // continuation bytes still expected
+    uint32_t utf8_code_point;
+
+    bool     parse_key_mode;  // after "^", buffered up until we encounter "^" again
+    char     parse_key_buffer[PARSE_KEY_LENGTH];
+    uint8_t  parse_key_buffer_index;
+    uint16_t parse_key_value;         // decimal value following the 2 characters (^TS20^)
+    uint8_t  parse_key_value_digits;  // PARSE_KEY_NO_VALUE once anything else than a digit was seen
+};
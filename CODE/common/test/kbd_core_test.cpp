@@ -0,0 +1,321 @@
+// Host tests of the shared translation core: the translator, and the cooperative
+// emitter driven by a fake KbdHal that records every line change with the time of
+// its clock.  Run by ctest, see CODE/common/CMakeLists.txt.
+//
+// Kept out of CODE/common itself, whose kbd_*.cpp files are copied next to the
+// Nano sketch.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "kbd_emitter.hpp"
+#include "kbd_translator.hpp"
+
+static int failures = 0;
+
+#define CHECK(condition) \
+  do { if (!(condition)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); failures++; } } while (0)
+
+// ----- Fake HAL -----
+
+// One line change, as the fake HAL saw it
+struct HalStep {
+  enum Kind : uint8_t { DATA, RELEASE, STROBE_ON, STROBE_OFF } kind;
+  uint32_t time_us;
+  uint8_t  scan_code;  // of DATA
+};
+
+class FakeKbdHal : public KbdHal
+{
+  public:
+    static const size_t MAX_STEPS = 64;
+
+    FakeKbdHal() : now(0), count(0) { }
+
+    void     set_data_lines(KbdKey key)   { record(HalStep::DATA, kbd_key_code(key)); }
+    void release_data_lines()             { record(HalStep::RELEASE, 0); }
+    void         set_strobe(bool pulled_low) { record(pulled_low ? HalStep::STROBE_ON : HalStep::STROBE_OFF, 0); }
+
+    // The clock only moves when waited on: the edges land exactly on their due times
+    uint32_t       now_us()                   { return now; }
+    void wait_until_us(uint32_t deadline_us) { if ((int32_t) (deadline_us - now) > 0) now = deadline_us; }
+
+    uint32_t now;
+    HalStep  steps[MAX_STEPS];
+    size_t   count;
+
+  private:
+    void record(HalStep::Kind kind, uint8_t scan_code)
+    {
+      if (count < MAX_STEPS) steps[count++] = HalStep { kind, now, scan_code };
+    }
+};
+
+// ----- Helpers -----
+
+static const size_t MAX_EVENTS = 64;
+
+struct Events {
+  KbdEvent events[MAX_EVENTS];
+  size_t   count;
+};
+
+// Translates the chunks in turn, as separate translate() calls
+static Events translate(KbdTranslator & translator, const char * const * chunks, size_t chunk_count)
+{
+  Events out = {};
+  for (size_t i = 0; i < chunk_count; i++) {
+    const size_t length = strlen(chunks[i]);
+    CHECK(translator.translate((const uint8_t *) chunks[i], length, out.events, MAX_EVENTS, out.count) == length);
+  }
+  return out;
+}
+
+static Events translate(KbdTranslator & translator, const char * in)
+{
+  return translate(translator, &in, 1);
+}
+
+static bool is_key(const KbdEvent & event, uint8_t scan_code)
+{
+  return (event.type == KbdEventType::KEY) && (event.value == kbd_key(scan_code));
+}
+
+static bool is_step(const HalStep & step, HalStep::Kind kind, uint32_t time_us, uint8_t scan_code = 0)
+{
+  return (step.kind == kind) && (step.time_us == time_us) && (step.scan_code == scan_code);
+}
+
+static const uint8_t KEY_EXECUTE    = 0xB2;
+static const uint8_t KEY_LEFT_ARROW = 0x34;  // backspace of the overstrikes
+static const uint8_t KEY_A          = 0x0B;
+static const uint8_t KEY_S          = 0xCB;
+
+// ----- Translator -----
+
+static void test_parse_key_split()
+{
+  KbdTranslator translator;
+  const char *  chunks[] = { "^E", "X^" };
+  const Events  out      = translate(translator, chunks, 2);
+
+  CHECK(out.count == 1);
+  CHECK(is_key(out.events[0], KEY_EXECUTE));
+  CHECK(!translator.in_parse_key());
+}
+
+static void test_crlf_single_execute()
+{
+  KbdTranslator translator(true);  // LF also an EXECUTE
+
+  Events out = translate(translator, "\r\n");
+  CHECK(out.count == 1);
+  CHECK(is_key(out.events[0], KEY_EXECUTE));
+
+  const char * chunks[] = { "a\r", "\na" };
+  out = translate(translator, chunks, 2);
+  CHECK(out.count == 3);
+  CHECK(is_key(out.events[0], KEY_A));
+  CHECK(is_key(out.events[1], KEY_EXECUTE));
+  CHECK(is_key(out.events[2], KEY_A));
+
+  out = translate(translator, "\n\n");
+  CHECK(out.count == 2);
+}
+
+static void test_compositions()
+{
+  KbdTranslator translator;
+
+  Events out = translate(translator, "!");  // ' overstruck with .
+  CHECK(out.count == 3);
+  CHECK(is_key(out.events[0], 0xFA));
+  CHECK(is_key(out.events[1], KEY_LEFT_ARROW));
+  CHECK(is_key(out.events[2], 0x89));
+
+  out = translate(translator, "[");  // a substitute character
+  CHECK(out.count == 1);
+  CHECK(is_key(out.events[0], 0x3A));
+
+  out = translate(translator, "\xE2\x8D\x8B");  // ⍋ : ∆ overstruck with |
+  CHECK(out.count == 3);
+  CHECK(is_key(out.events[0], 0x6A));
+  CHECK(is_key(out.events[1], KEY_LEFT_ARROW));
+  CHECK(is_key(out.events[2], 0x78));
+
+  out = translate(translator, "\xE2\x8D\xBA");  // ⍺ : a key of its own
+  CHECK(out.count == 1);
+  CHECK(is_key(out.events[0], 0x0A));
+}
+
+static void test_utf8_split()
+{
+  KbdTranslator translator;
+  const char *  chunks[] = { "\xE2", "\x8D", "\x8B" };
+  const Events  out      = translate(translator, chunks, 3);
+
+  CHECK(out.count == 3);
+  CHECK(is_key(out.events[0], 0x6A));
+
+  // An ASCII character ends an incomplete sequence, the next continuation byte is ignored
+  const char * broken[] = { "\xE2\x8D", "a", "\x8B" };
+  const Events out2     = translate(translator, broken, 3);
+  CHECK(out2.count == 1);
+  CHECK(is_key(out2.events[0], KEY_A));
+}
+
+static void test_timing_parse_keys()
+{
+  KbdTranslator translator;
+
+  Events out = translate(translator, "^TS20^");
+  CHECK(out.count == 1);
+  CHECK((out.events[0].type == KbdEventType::SETUP_US) && (out.events[0].value == 20));
+
+  out = translate(translator, "^TG65535^");
+  CHECK(out.count == 1);
+  CHECK((out.events[0].type == KbdEventType::GAP_US) && (out.events[0].value == 65535));
+
+  CHECK(translate(translator, "^TS^").count == 0);       // no value
+  CHECK(translate(translator, "^TS65536^").count == 0);  // out of range
+  CHECK(translate(translator, "^TS1x^").count == 0);     // not a number
+
+  out = translate(translator, "a");  // none of the above left the translator in a parse key
+  CHECK(out.count == 1);
+  CHECK(is_key(out.events[0], KEY_A));
+}
+
+// ----- Emitter -----
+
+static KbdProfile profile_with_timing(uint16_t setup_us, uint16_t strobe_us, uint16_t hold_us, uint16_t gap_us)
+{
+  KbdProfile profile = kbd_profile_5110;
+  profile.timing     = KbdTiming { setup_us, strobe_us, hold_us, gap_us };
+  return profile;
+}
+
+static void test_emitter_edges()
+{
+  const KbdProfile profile = profile_with_timing(5, 20, 3, 40);
+  FakeKbdHal       hal;
+  KbdEmitter       emitter(hal, profile);
+  const KbdEvent   events[] = {
+    { KbdEventType::KEY, kbd_key(KEY_A) },
+    { KbdEventType::KEY, kbd_key(KEY_S) }
+  };
+
+  CHECK(emitter.emit(events, 2) == 2);
+  emitter.flush();
+
+  CHECK(hal.count == 7);
+  CHECK(is_step(hal.steps[0], HalStep::DATA, 0, KEY_A));
+  CHECK(is_step(hal.steps[1], HalStep::STROBE_ON, 5));    // after the setup
+  CHECK(is_step(hal.steps[2], HalStep::STROBE_OFF, 25));  // strobe width
+  CHECK(is_step(hal.steps[3], HalStep::DATA, 28, KEY_S)); // after the hold
+  CHECK(is_step(hal.steps[4], HalStep::STROBE_ON, 65));   // gap from the last strobe off, longer than hold + setup
+  CHECK(is_step(hal.steps[5], HalStep::STROBE_OFF, 85));
+  CHECK(is_step(hal.steps[6], HalStep::RELEASE, 88));
+  CHECK(emitter.idle());
+}
+
+static void test_emitter_timing_events()
+{
+  const KbdProfile profile = profile_with_timing(5, 20, 3, 40);
+  FakeKbdHal       hal;
+  KbdEmitter       emitter(hal, profile);
+  KbdTranslator    translator;
+  const Events     out = translate(translator, "^TS0^^TW7^^TH0^^TG0^a");
+
+  CHECK(emitter.emit(out.events, out.count) == out.count);
+  emitter.flush();
+
+  // Zero setup, hold and gap times
+  CHECK(hal.count == 4);
+  CHECK(is_step(hal.steps[0], HalStep::DATA, 0, KEY_A));
+  CHECK(is_step(hal.steps[1], HalStep::STROBE_ON, 0));
+  CHECK(is_step(hal.steps[2], HalStep::STROBE_OFF, 7));
+  CHECK(is_step(hal.steps[3], HalStep::RELEASE, 7));
+  CHECK(emitter.get_timing().strobe_us == 7);
+}
+
+static void test_emitter_delay()
+{
+  const KbdProfile profile = profile_with_timing(5, 20, 3, 40);
+  FakeKbdHal       hal;
+  KbdEmitter       emitter(hal, profile);
+  const KbdEvent   events[] = {
+    { KbdEventType::KEY,   kbd_key(KEY_A) },
+    { KbdEventType::DELAY, 2 },  // milliseconds
+    { KbdEventType::KEY,   kbd_key(KEY_S) }
+  };
+
+  CHECK(emitter.emit(events, 3) == 3);
+  emitter.flush();
+
+  CHECK(hal.count == 8);
+  CHECK(is_step(hal.steps[3], HalStep::RELEASE, 28));  // the delay starts after the hold
+  CHECK(is_step(hal.steps[4], HalStep::DATA, 2028, KEY_S));
+  CHECK(is_step(hal.steps[5], HalStep::STROBE_ON, 2033));
+}
+
+static void test_queue_full()
+{
+  FakeKbdHal hal;
+  KbdEmitter emitter(hal);
+  KbdEvent   events[KbdEmitter::QUEUE_SIZE + 6];
+
+  for (size_t i = 0; i < sizeof(events) / sizeof(*events); i++) events[i] = KbdEvent { KbdEventType::KEY, kbd_key(KEY_A) };
+
+  CHECK(emitter.emit(events, sizeof(events) / sizeof(*events)) == KbdEmitter::QUEUE_SIZE);
+  CHECK(emitter.space() == 0);
+  CHECK(emitter.get_queue().get_overflows() == 6);
+  CHECK(emitter.get_queue().get_high_water() == KbdEmitter::QUEUE_SIZE);
+  CHECK(emitter.get_queue().get_blocked() == 0);
+
+  emitter.flush();
+  CHECK(emitter.space() == KbdEmitter::QUEUE_SIZE);
+  CHECK(emitter.get_queue().get_overflows() == 6);  // counters are not reset by draining
+}
+
+static void test_ring_counters()
+{
+  KbdEventRing<uint8_t, 4> ring;
+  const KbdEvent           event = { KbdEventType::KEY, kbd_key(KEY_A) };
+  KbdEvent                 popped;
+
+  for (int i = 0; i < 4; i++) CHECK(ring.push(event));
+  CHECK(!ring.push(event));
+  CHECK(ring.get_overflows() == 0);  // a failed push counts nothing by itself
+  CHECK(ring.get_blocked() == 0);
+
+  ring.count_blocked();
+  ring.count_dropped(3);
+  CHECK(ring.get_blocked() == 1);
+  CHECK(ring.get_overflows() == 3);
+
+  CHECK(ring.pop(popped) && is_key(popped, KEY_A));
+  CHECK(ring.push(event));
+  CHECK(ring.count() == 4);
+  CHECK(ring.get_high_water() == 4);
+}
+
+int main()
+{
+  test_parse_key_split();
+  test_crlf_single_execute();
+  test_compositions();
+  test_utf8_split();
+  test_timing_parse_keys();
+  test_emitter_edges();
+  test_emitter_timing_events();
+  test_emitter_delay();
+  test_queue_full();
+  test_ring_counters();
+
+  if (failures != 0) {
+    printf("%d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("all checks passed\n");
+  return 0;
+}
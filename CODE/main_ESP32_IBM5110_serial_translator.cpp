@@ -0,0 +1,170 @@
+/*
+Compiled and uploaded to ESP32 10/1/2022
+Verified working with IBM 5110 Type 2
+
+The Arduino version is in 5110KBD.ino
+See the notes at the top of that, the usage is identical.
+
+   IBM kbd Connector                  ESP32
+                                    (USB connector on this side)
+   B04/KBD_P --------\/\/330ohm\/\/\---- D0   0
+   B12/KBD_7 --------\/\/330ohm\/\/\---- D15  15
+   B13/KBD_6 --------\/\/330ohm\/\/\---- D2   2
+   B10/KBD_5 --------\/\/330ohm\/\/\---- D4   4
+   B09/KBD_4 --------\/\/330ohm\/\/\---- RX2  16
+   B08/KBD_3 --------\/\/330ohm\/\/\---- TX2  17
+   D13/KBD_2 --------\/\/330ohm\/\/\---- D5   5 
+   D06/KBD_1 --------\/\/330ohm\/\/\---- D18  18
+   B05/KBD_0 --------\/\/330ohm\/\/\---- D19  19
+   B07/KBD_STROBE----\/\/330ohm\/\/\---- D21  21
+                                   (Wireless chip towards this side)
+
+FLOW CONTROL
+The serial input (UART0) is read from the ESP-IDF UART driver, with a 2KB receive buffer.
+^FX^ turns on XON/XOFF and ^FH^ RTS/CTS flow control, ^FN^ turns it off (the default at power up).
+Both are done by the UART itself, on the level of its 128 byte receive FIFO: once the driver
+buffer is full (the keys can't be typed as fast as they arrive), the driver stops draining the
+FIFO, and the UART sends XOFF / releases RTS when the FIFO gets past UART_XOFF_LEVEL /
+UART_RTS_LEVEL, then XON once it is drained below UART_XON_LEVEL.  The host can then send at
+any baud rate without losing bytes, and without ^Dx^ delays or terminal pacing.
+
+RTS/CTS needs a USB serial adapter with those lines, wired to UART0 (TX0 / RX0) and:
+   adapter CTS ---------------------------- D22  22  (RTS output)
+   adapter RTS ---------------------------- D23  23  (CTS input)
+(The default UART0 CTS pin, GPIO19, is KBD_0.)  The chip on the board does not bring them out.
+
+*/
+#include <stdio.h>
+
+#include "driver/uart.h"
+#include "esp_vfs_dev.h"
+
+// CODE/common, add it to the SRCS and INCLUDE_DIRS of the main component
+#include "kbd_hal_esp32.hpp"
+#include "kbd_emitter_esp32.hpp"
+#include "kbd_translator.hpp"
+
+static Esp32KbdIsrEmitter kbd_emitter;
+static KbdTranslator      kbd_translator(true);  // (VSCODE environment is translating ENTER as NEWLINE 10 instead of CARRIAGE RETURN 13)
+
+static uint32_t uart_fifo_overflows;           // UART FIFO overflows, the input of each was dropped
+static uint32_t uart_fifo_overflows_reported;  // printed by report_overflows()
+
+#define MAX_INPUT_BYTES_AT_A_TIME 128  // a whole FIFO
+
+#define UART_PORT             UART_NUM_0
+#define UART_RX_BUFFER_SIZE   2048
+#define UART_EVENT_QUEUE_SIZE 16
+#define UART_RX_FULL_LEVEL    64     // FIFO bytes, below the flow control levels
+#define UART_RX_TIMEOUT       2      // characters of idle line before the bytes in the FIFO are passed on
+#define PIN_UART_RTS        22
+#define PIN_UART_CTS        23
+
+// Receive FIFO levels (of UART_FIFO_LEN bytes) of the flow control, see FLOW CONTROL above
+#define UART_XOFF_LEVEL     96
+#define UART_XON_LEVEL      32
+#define UART_RTS_LEVEL      96
+
+// The input is read straight from the UART driver: the receive interrupt moves the FIFO to
+// the driver buffer, and posts a UART_DATA event once UART_RX_FULL_LEVEL bytes are in the FIFO
+// or the line has been idle for UART_RX_TIMEOUT characters.  The task sleeps on the event
+// queue in between.  (The UART of the ESP32 has no DMA of its own, the driver empties the
+// FIFO from its interrupt.)  printf() goes through the driver too.
+static QueueHandle_t uart_events;
+
+static void uart_begin()
+{
+    uart_driver_install(UART_PORT, UART_RX_BUFFER_SIZE, 0, UART_EVENT_QUEUE_SIZE, &uart_events, 0);
+    uart_set_pin(UART_PORT, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE, PIN_UART_RTS, PIN_UART_CTS);
+    uart_set_rx_full_threshold(UART_PORT, UART_RX_FULL_LEVEL);
+    uart_set_rx_timeout(UART_PORT, UART_RX_TIMEOUT);
+    esp_vfs_dev_uart_use_driver(UART_PORT);
+}
+
+// ^FN^ ^FX^ ^FH^
+static void uart_set_flow_control(uint8_t flow)
+{
+    uart_set_sw_flow_ctrl(UART_PORT, flow == KBD_FLOW_XON_XOFF, UART_XON_LEVEL, UART_XOFF_LEVEL);
+    uart_set_hw_flow_ctrl(UART_PORT, (flow == KBD_FLOW_RTS_CTS) ? UART_HW_FLOWCTRL_CTS_RTS : UART_HW_FLOWCTRL_DISABLE, UART_RTS_LEVEL);
+}
+
+static uint8_t  received[MAX_INPUT_BYTES_AT_A_TIME];
+static KbdEvent events[MAX_INPUT_BYTES_AT_A_TIME * KbdTranslator::MAX_EVENTS_PER_BYTE];
+
+// Translates and emits all the input buffered by the driver, a batch at a time
+static void process_input()
+{
+    int received_count;
+
+    while ((received_count = uart_read_bytes(UART_PORT, received, MAX_INPUT_BYTES_AT_A_TIME, 0)) > 0)
+    {
+        size_t event_count = 0;
+
+        kbd_translator.translate(received, received_count, events, sizeof(events) / sizeof(*events), event_count);
+
+        for (size_t i = 0; i < event_count; i++)
+        {
+            if ((events[i].type == KbdEventType::MODE) && (kbd_mode_arg_mode(events[i].value) == KbdMode::FLOW_CONTROL))
+            {
+                uart_set_flow_control(kbd_mode_arg_value(events[i].value));
+            }
+        }
+
+        // Queued, played by the timer interrupt.  Only waits when the queue is full: the UART
+        // driver buffer then fills up, and the flow control stops the host.
+        kbd_emitter.emit(events, event_count);
+    }
+}
+
+// Prints the FIFO overflows since the last report.  Only called once no UART event is
+// waiting, so that printing doesn't delay the input any further.
+static void report_overflows()
+{
+    if ((uart_fifo_overflows == uart_fifo_overflows_reported) || (uxQueueMessagesWaiting(uart_events) != 0)) return;
+
+    printf("UART FIFO OVERFLOW, INPUT LOST (%u)\n", (unsigned) uart_fifo_overflows);
+    uart_fifo_overflows_reported = uart_fifo_overflows;
+}
+
+extern "C" void app_main(void)
+{
+    Esp32KbdHal::configure_pins();
+    kbd_emitter.begin();
+    uart_begin();
+
+    printf("HOST-TO-IBM5110 KEY TRANSLATION BEGIN (%s)\n", kbd_translator.get_profile().name);
+
+    // BEGIN MAIN LOOP EXECUTIVE...
+    while (1) 
+    {
+        uart_event_t event;
+
+        if (xQueueReceive(uart_events, &event, portMAX_DELAY) != pdTRUE) continue;
+
+        switch (event.type)
+        {
+            case UART_DATA:
+                process_input();
+                break;
+
+            case UART_BUFFER_FULL:
+                // The keys are behind: expected with flow control, the UART stops the host until
+                // process_input() makes room.  Without it, the bytes that don't fit are lost.
+                process_input();
+                break;
+
+            case UART_FIFO_OVF:
+                // The driver stops taking the FIFO: its recovery is to drop the buffered input
+                // and the events that refer to it.  The host has to send the lost text again.
+                uart_fifo_overflows++;
+                uart_flush_input(UART_PORT);
+                xQueueReset(uart_events);
+                break;
+
+            default:
+                break;
+        }
+
+        report_overflows();
+    }
+}
@@ -46,16 +46,6 @@ const char *      BTKeyboard::ble_gap_evt_names[] = { "ADV_DATA_SET_COMPLETE", "
 const char *       BTKeyboard::bt_gap_evt_names[] = { "DISC_RES", "DISC_STATE_CHANGED", "RMT_SRVCS", "RMT_SRVC_REC", "AUTH_CMPL", "PIN_REQ", "CFM_REQ", "KEY_NOTIF", "KEY_REQ", "READ_RSSI_DELTA" };
 const char *    BTKeyboard::ble_addr_type_names[] = { "PUBLIC", "RANDOM", "RPA_PUBLIC", "RPA_RANDOM" };
 
-const char BTKeyboard::shift_trans_dict[] = 
-  "aAbBcCdDeEfFgGhHiIjJkKlLmMnNoOpPqQrRsStTuUvVwWxXyYzZ1!2@3#4$5%6^7&8*9(0)"
-  "\r\r\033\033\b\b\t\t  -_=+[{]}\\|??;:'\"`~,<.>/?"
-  "\200\200"                                            // CAPS LOC
-  "\201\201\202\202\203\203\204\204\205\205\206\206"    // F1..F6
-  "\207\207\210\210\211\211\212\212\213\213\214\214"    // F7..F12
-  "\215\215\216\216\217\217"                            // PrintScreen ScrollLock Pause
-  "\220\220\221\221\222\222\177\177"                    // Insert Home PageUp Delete
-  "\223\223\224\224\225\225\226\226\227\227\230\230";   // End PageDown Right Left Dow Up
-
 static BTKeyboard * bt_keyboard = nullptr;
 
 const char * 
@@ -143,33 +133,77 @@ BTKeyboard::print_uuid(esp_bt_uuid_t * uuid)
   }
 }
 
+// The scan results live in a fixed pool, found back by a hash of their address (open
+// addressing, the index being twice the size of the pool), with their names in an arena:
+// a scan costs no heap, and each discovery event a few probes at most.
 void 
-BTKeyboard::esp_hid_scan_results_free(esp_hid_scan_result_t * results)
+BTKeyboard::clear_scan_results()
 {
-  esp_hid_scan_result_t *r = nullptr;
-  while (results) {
-    r = results;
-    results = results->next;
-    if (r->name != nullptr) {
-      free((char *)r->name);
-    }
-    free(r);
-  }
+  memset(scan_index, SCAN_INDEX_FREE, sizeof(scan_index));
+  scan_result_count    = 0;
+  scan_names_used      = 0;
+  bt_scan_results      = nullptr;
+  ble_scan_results     = nullptr;
+  num_bt_scan_results  = 0;
+  num_ble_scan_results = 0;
+}
+
+uint8_t
+BTKeyboard::scan_hash(const esp_bd_addr_t bda, esp_hid_transport_t transport)
+{
+  uint8_t hash = (uint8_t) transport;
+
+  for (int i = 0; i < ESP_BD_ADDR_LEN; i++) hash = (hash * 31) + bda[i];
+  return hash & (SCAN_INDEX_SIZE - 1);
 }
 
 BTKeyboard::esp_hid_scan_result_t *
-BTKeyboard::find_scan_result(esp_bd_addr_t bda, esp_hid_scan_result_t * results)
+BTKeyboard::find_scan_result(const esp_bd_addr_t bda, esp_hid_transport_t transport)
 {
-  esp_hid_scan_result_t *r = results;
-  while (r) {
-    if (memcmp(bda, r->bda, sizeof(esp_bd_addr_t)) == 0) {
+  for (uint8_t i = scan_hash(bda, transport); scan_index[i] != SCAN_INDEX_FREE; i = (i + 1) & (SCAN_INDEX_SIZE - 1)) {
+    esp_hid_scan_result_t * r = &scan_results[scan_index[i]];
+    if ((r->transport == transport) && (memcmp(bda, r->bda, sizeof(esp_bd_addr_t)) == 0)) {
       return r;
     }
-    r = r->next;
   }
   return nullptr;
 }
 
+// A new result of the pool, indexed by its address (set here), nullptr once full
+BTKeyboard::esp_hid_scan_result_t *
+BTKeyboard::new_scan_result(const esp_bd_addr_t bda, esp_hid_transport_t transport)
+{
+  if (scan_result_count >= SCAN_RESULT_CAPACITY) {
+    ESP_LOGW(TAG, "Too many scan results, " ESP_BD_ADDR_STR " ignored", ESP_BD_ADDR_HEX(bda));
+    return nullptr;
+  }
+
+  uint8_t i = scan_hash(bda, transport);
+  while (scan_index[i] != SCAN_INDEX_FREE) i = (i + 1) & (SCAN_INDEX_SIZE - 1);
+  scan_index[i] = scan_result_count;
+
+  esp_hid_scan_result_t * r = &scan_results[scan_result_count++];
+  memset(r, 0, sizeof(esp_hid_scan_result_t));
+  memcpy(r->bda, bda, sizeof(esp_bd_addr_t));
+  r->transport = transport;
+  return r;
+}
+
+// A copy of the name in the arena, nullptr when there is none or no room left for it
+const char *
+BTKeyboard::intern_name(const uint8_t * name, uint8_t name_len)
+{
+  if ((name == nullptr) || (name_len == 0) || (name_len >= (SCAN_NAME_ARENA_SIZE - scan_names_used))) {
+    return nullptr;
+  }
+
+  char * s = &scan_names[scan_names_used];
+  memcpy(s, name, name_len);
+  s[name_len] = 0;
+  scan_names_used += name_len + 1;
+  return s;
+}
+
 void 
 BTKeyboard::add_bt_scan_result(esp_bd_addr_t   bda, 
                                esp_bt_cod_t  * cod, 
@@ -178,18 +212,11 @@ BTKeyboard::add_bt_scan_result(esp_bd_addr_t   bda,
                                uint8_t         name_len, 
                                int             rssi)
 {
-  esp_hid_scan_result_t *r = find_scan_result(bda, bt_scan_results);
+  esp_hid_scan_result_t *r = find_scan_result(bda, ESP_HID_TRANSPORT_BT);
   if (r) {
     //Some info may come later
-    if (r->name == nullptr && name && name_len) {
-      char *name_s = (char *)malloc(name_len + 1);
-      if (name_s == nullptr) {
-        ESP_LOGE(TAG, "Malloc result name failed!");
-        return;
-      }
-      memcpy(name_s, name, name_len);
-      name_s[name_len] = 0;
-      r->name = (const char *)name_s;
+    if (r->name == nullptr) {
+      r->name = intern_name(name, name_len);
     }
     if (r->bt.uuid.len == 0 && uuid->len) {
       memcpy(&r->bt.uuid, uuid, sizeof(esp_bt_uuid_t));
@@ -197,40 +224,25 @@ BTKeyboard::add_bt_scan_result(esp_bd_addr_t   bda,
     if (rssi != 0) {
       r->rssi = rssi;
     }
+    scan_found(r);
     return;
   }
 
-  r = (esp_hid_scan_result_t *) malloc(sizeof(esp_hid_scan_result_t));
-
-  if (r == nullptr) {
-    ESP_LOGE(TAG, "Malloc bt_hidh_scan_result_t failed!");
-    return;
-  }
-
-  r->transport = ESP_HID_TRANSPORT_BT;
+  if ((r = new_scan_result(bda, ESP_HID_TRANSPORT_BT)) == nullptr) return;
 
-  memcpy(r->bda, bda, sizeof(esp_bd_addr_t));
   memcpy(&r->bt.cod, cod, sizeof(esp_bt_cod_t));
   memcpy(&r->bt.uuid, uuid, sizeof(esp_bt_uuid_t));
 
-  r->usage = esp_hid_usage_from_cod((uint32_t)cod);
+  uint32_t cod_value;
+  memcpy(&cod_value, cod, sizeof(cod_value));
+  r->usage = esp_hid_usage_from_cod(cod_value);
   r->rssi  = rssi;
-  r->name  = nullptr;
+  r->name  = intern_name(name, name_len);
 
-  if (name_len && name) {
-    char *name_s = (char *)malloc(name_len + 1);
-    if (name_s == nullptr) {
-      free(r);
-      ESP_LOGE(TAG, "Malloc result name failed!");
-      return;
-    }
-    memcpy(name_s, name, name_len);
-    name_s[name_len] = 0;
-    r->name = (const char *)name_s;
-  }
   r->next = bt_scan_results;
   bt_scan_results = r;
   num_bt_scan_results++;
+  scan_found(r);
 }
 
 void 
@@ -241,47 +253,80 @@ BTKeyboard::add_ble_scan_result(esp_bd_addr_t       bda,
                                 uint8_t             name_len, 
                                 int                 rssi)
 {
-  if (find_scan_result(bda, ble_scan_results)) {
-    ESP_LOGW(TAG, "Result already exists!");
-    return;
-  }
-
-  esp_hid_scan_result_t *r = (esp_hid_scan_result_t *)malloc(sizeof(esp_hid_scan_result_t));
-
-  if (r == nullptr) {
-    ESP_LOGE(TAG, "Malloc ble_hidh_scan_result_t failed!");
+  esp_hid_scan_result_t *r = find_scan_result(bda, ESP_HID_TRANSPORT_BLE);
+  if (r) {
+    // Seen again (scan response...): the appearance may only come now
+    if (r->name == nullptr) {
+      r->name = intern_name(name, name_len);
+    }
+    if ((r->ble.appearance == 0) && (appearance != 0)) {
+      r->ble.appearance = appearance;
+      r->usage          = esp_hid_usage_from_appearance(appearance);
+    }
+    r->rssi = rssi;
+    scan_found(r);
     return;
   }
 
-  r->transport = ESP_HID_TRANSPORT_BLE;
-
-  memcpy(r->bda, bda, sizeof(esp_bd_addr_t));
+  if ((r = new_scan_result(bda, ESP_HID_TRANSPORT_BLE)) == nullptr) return;
 
   r->ble.appearance = appearance;
   r->ble.addr_type  = addr_type;
   r->usage          = esp_hid_usage_from_appearance(appearance);
   r->rssi           = rssi;
-  r->name           = nullptr;
-
-  if (name_len && name) {
-    char *name_s = (char *)malloc(name_len + 1);
-    if (name_s == nullptr) {
-      free(r);
-      ESP_LOGE(TAG, "Malloc result name failed!");
-      return;
-    }
-    memcpy(name_s, name, name_len);
-    name_s[name_len] = 0;
-    r->name = (const char *)name_s;
-  }
+  r->name           = intern_name(name, name_len);
 
   r->next = ble_scan_results;
   ble_scan_results = r;
   num_ble_scan_results++;
+  scan_found(r);
+}
+
+// On the GAP callbacks (both run on the Bluedroid BTC task): the first keyboard found
+// stops both scans, there is no point in waiting for the others.
+void
+BTKeyboard::scan_found(const esp_hid_scan_result_t * r)
+{
+  if (((r->usage & ESP_HID_USAGE_KEYBOARD) == 0) || scan_stopping) return;
+
+  ESP_LOGV(TAG, "Keyboard found: " ESP_BD_ADDR_STR ", stopping the scan", ESP_BD_ADDR_HEX(r->bda));
+  scan_stopping = true;
+  if (ble_scanning) esp_ble_gap_stop_scanning();
+  if (bt_scanning)  esp_bt_gap_cancel_discovery();
+}
+
+// Keyboards first, then by signal strength (the closest device is most likely the one
+// being paired)
+bool
+BTKeyboard::ranks_before(const esp_hid_scan_result_t * a, const esp_hid_scan_result_t * b)
+{
+  const bool a_keyboard = (a->usage & ESP_HID_USAGE_KEYBOARD) != 0;
+  const bool b_keyboard = (b->usage & ESP_HID_USAGE_KEYBOARD) != 0;
+
+  if (a_keyboard != b_keyboard) return a_keyboard;
+  return a->rssi > b->rssi;
+}
+
+// Insertion sort of the list, best first
+BTKeyboard::esp_hid_scan_result_t *
+BTKeyboard::rank_scan_results(esp_hid_scan_result_t * results)
+{
+  esp_hid_scan_result_t * ranked = nullptr;
+
+  while (results) {
+    esp_hid_scan_result_t *  r = results;
+    esp_hid_scan_result_t ** p = &ranked;
+
+    results = r->next;
+    while ((*p != nullptr) && !ranks_before(r, *p)) p = &(*p)->next;
+    r->next = *p;
+    *p      = r;
+  }
+  return ranked;
 }
 
 bool 
-BTKeyboard::setup(pid_handler * handler)
+BTKeyboard::setup(pid_handler * handler, UBaseType_t depth)
 {
   esp_err_t ret;
   const esp_bt_mode_t mode = HID_HOST_MODE;
@@ -294,7 +339,12 @@ BTKeyboard::setup(pid_handler * handler)
   bt_keyboard = this;
 
   pairing_handler = handler;
-  event_queue = xQueueCreate(10, sizeof(KeyInfo));
+  queue_depth = depth;
+  event_queue = xQueueCreate(queue_depth, sizeof(Report));
+  if (event_queue == nullptr) {
+    ESP_LOGE(TAG, "xQueueCreate failed!");
+    return false;
+  }
 
   if (HID_HOST_MODE == HIDH_IDLE_MODE) {
     ESP_LOGE(TAG, "Please turn on BT HID host or BLE!");
@@ -315,6 +365,18 @@ BTKeyboard::setup(pid_handler * handler)
     return false;
   }
 
+  open_semaphore = xSemaphoreCreateBinary();
+  if (open_semaphore == nullptr) {
+    ESP_LOGE(TAG, "xSemaphoreCreateBinary failed!");
+    return false;
+  }
+
+  open_lock = xSemaphoreCreateMutex();
+  if (open_lock == nullptr) {
+    ESP_LOGE(TAG, "xSemaphoreCreateMutex failed!");
+    return false;
+  }
+
   esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
 
   bt_cfg.mode             = mode;
@@ -377,6 +439,20 @@ BTKeyboard::setup(pid_handler * handler)
     return false;
   }
 
+  // Bonding, for the keys to be kept: the keyboard of the last session is then opened
+  // directly, its link encrypted with them.  The passkey a keyboard asks to be typed is
+  // shown by the pairing handler (ESP_GAP_BLE_PASSKEY_NOTIF_EVT).
+  esp_ble_auth_req_t auth_req  = ESP_LE_AUTH_REQ_SC_MITM_BOND;
+  esp_ble_io_cap_t   ble_iocap = ESP_IO_CAP_OUT;
+  uint8_t            key_size  = 16;
+  uint8_t            init_key  = ESP_BLE_ENC_KEY_MASK | ESP_BLE_ID_KEY_MASK;
+  uint8_t            rsp_key   = ESP_BLE_ENC_KEY_MASK | ESP_BLE_ID_KEY_MASK;
+  esp_ble_gap_set_security_param(ESP_BLE_SM_AUTHEN_REQ_MODE, &auth_req,  sizeof(uint8_t));
+  esp_ble_gap_set_security_param(ESP_BLE_SM_IOCAP_MODE,      &ble_iocap, sizeof(uint8_t));
+  esp_ble_gap_set_security_param(ESP_BLE_SM_MAX_KEY_SIZE,    &key_size,  sizeof(uint8_t));
+  esp_ble_gap_set_security_param(ESP_BLE_SM_SET_INIT_KEY,    &init_key,  sizeof(uint8_t));
+  esp_ble_gap_set_security_param(ESP_BLE_SM_SET_RSP_KEY,     &rsp_key,   sizeof(uint8_t));
+
   ESP_ERROR_CHECK(esp_ble_gattc_register_callback(esp_hidh_gattc_event_handler));
   esp_hidh_config_t config = {
     .callback = hidh_callback,
@@ -385,12 +461,28 @@ BTKeyboard::setup(pid_handler * handler)
   };
   ESP_ERROR_CHECK(esp_hidh_init(&config));
 
-  for (int i = 0; i < MAX_KEY_COUNT; i++) {
-    key_avail[i] = true;
+  for (Device & device : devices) {
+    esp_timer_create_args_t repeat_timer_args = {
+      .callback              = repeat_timer_callback,
+      .arg                   = &device,
+      .dispatch_method       = ESP_TIMER_TASK,
+      .name                  = "typematic",
+      .skip_unhandled_events = true
+    };
+    if ((ret = esp_timer_create(&repeat_timer_args, &device.repeat_timer))) {
+      ESP_LOGE(TAG, "esp_timer_create failed: %d", ret);
+      return false;
+    }
+  }
+
+  if (xTaskCreate(reconnect_task, "reconnect", RECONNECT_TASK_STACK_SIZE, this,
+                  RECONNECT_TASK_PRIORITY, &reconnect_task_handle) != pdPASS) {
+    ESP_LOGE(TAG, "xTaskCreate failed!");
+    return false;
   }
 
-  last_ch = 0;
   battery_level = -1;
+  load_last_keyboard();
   return true;
 }
 
@@ -492,7 +584,7 @@ BTKeyboard::handle_bt_device_result(esp_bt_gap_cb_param_t * param)
   GAP_DBG_PRINTF("\n");
 
   if ((cod->major == ESP_BT_COD_MAJOR_DEV_PERIPHERAL) || 
-      (find_scan_result(param->disc_res.bda, bt_scan_results) != nullptr)) {
+      (find_scan_result(param->disc_res.bda, ESP_HID_TRANSPORT_BT) != nullptr)) {
     add_bt_scan_result(param->disc_res.bda, cod, &uuid, name, name_len, rssi);
   }
 }
@@ -504,6 +596,7 @@ BTKeyboard::bt_gap_event_handler(esp_bt_gap_cb_event_t event, esp_bt_gap_cb_para
     case ESP_BT_GAP_DISC_STATE_CHANGED_EVT: {
       ESP_LOGV(TAG, "BT GAP DISC_STATE %s", (param->disc_st_chg.state == ESP_BT_GAP_DISCOVERY_STARTED) ? "START" : "STOP");
       if (param->disc_st_chg.state == ESP_BT_GAP_DISCOVERY_STOPPED) {
+        bt_keyboard->bt_scanning = false;
         SEND_BT_CB();
       }
       break;
@@ -570,7 +663,8 @@ BTKeyboard::handle_ble_device_result(esp_ble_gap_cb_param_t * param)
   GAP_DBG_PRINTF("\n");
 
   #if SCAN
-    if (uuid == ESP_GATT_UUID_HID_SVC) {
+    // A scan response seldom repeats the service UUID of the advertising data before it
+    if ((uuid == ESP_GATT_UUID_HID_SVC) || (find_scan_result(param->scan_rst.bda, ESP_HID_TRANSPORT_BLE) != nullptr)) {
       add_ble_scan_result(param->scan_rst.bda, 
                           param->scan_rst.ble_addr_type, 
                           appearance, adv_name, adv_name_len, 
@@ -598,6 +692,7 @@ void BTKeyboard::ble_gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap
         }
         case ESP_GAP_SEARCH_INQ_CMPL_EVT:
           ESP_LOGV(TAG, "BLE GAP EVENT SCAN DONE: %d", param->scan_rst.num_resps);
+          bt_keyboard->ble_scanning = false;
           SEND_BLE_CB();
           break;
         default:
@@ -607,6 +702,8 @@ void BTKeyboard::ble_gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap
     }
     case ESP_GAP_BLE_SCAN_STOP_COMPLETE_EVT: {
       ESP_LOGV(TAG, "BLE GAP EVENT SCAN CANCELED");
+      bt_keyboard->ble_scanning = false;
+      SEND_BLE_CB();  // stopped by scan_found(), no SCAN DONE then
       break;
     }
 
@@ -709,24 +806,25 @@ BTKeyboard::start_ble_scan(uint32_t seconds)
 esp_err_t 
 BTKeyboard::esp_hid_scan(uint32_t seconds, size_t *num_results, esp_hid_scan_result_t **results)
 {
-  if (num_bt_scan_results || bt_scan_results || num_ble_scan_results || ble_scan_results) {
-    ESP_LOGE(TAG, "There are old scan results. Free them first!");
-    return ESP_FAIL;
-  }
+  clear_scan_results();  // of the previous scan
 
-  if (start_ble_scan(seconds) == ESP_OK) {
-    WAIT_BLE_CB();
-  } 
-  else {
-    return ESP_FAIL;
-  }
+  // Both scans run at once, until the time is up or a keyboard is found (see scan_found())
+  xSemaphoreTake(bt_hidh_cb_semaphore,  0);  // left by the stop of an earlier scan
+  xSemaphoreTake(ble_hidh_cb_semaphore, 0);
+  scan_stopping = false;
 
-  if (start_bt_scan(seconds) == ESP_OK) {
-    WAIT_BT_CB();
-  } 
-  else {
-    return ESP_FAIL;
-  }
+  ble_scanning = true;
+  const bool ble_started = (start_ble_scan(seconds) == ESP_OK);
+  if (!ble_started) ble_scanning = false;
+
+  bt_scanning = !scan_stopping;
+  const bool bt_started = bt_scanning && (start_bt_scan(seconds) == ESP_OK);
+  if (!bt_started) bt_scanning = false;
+
+  if (ble_started) WAIT_BLE_CB();
+  if (bt_started)  WAIT_BT_CB();
+
+  if (!ble_started && !bt_started) return ESP_FAIL;
 
   *num_results = num_bt_scan_results + num_ble_scan_results;
   *results = bt_scan_results;
@@ -741,6 +839,8 @@ BTKeyboard::esp_hid_scan(uint32_t seconds, size_t *num_results, esp_hid_scan_res
     *results = ble_scan_results;
   }
 
+  *results = rank_scan_results(*results);
+
   num_bt_scan_results = 0;
   bt_scan_results = NULL;
   num_ble_scan_results = 0;
@@ -762,18 +862,15 @@ BTKeyboard::devices_scan( int seconds_wait_time)
   ESP_LOGV(TAG, "SCAN: %u results", results_len);
   if (results_len) {
     esp_hid_scan_result_t *r = results;
-    esp_hid_scan_result_t *cr = NULL;
     while (r) {
       printf("  %s: " ESP_BD_ADDR_STR ", ", (r->transport == ESP_HID_TRANSPORT_BLE) ? "BLE" : "BT ", ESP_BD_ADDR_HEX(r->bda));
       printf("RSSI: %d, ", r->rssi);
       printf("USAGE: %s, ", esp_hid_usage_str(r->usage));
       if (r->transport == ESP_HID_TRANSPORT_BLE) {
-        cr = r;
         printf("APPEARANCE: 0x%04x, ", r->ble.appearance);
         printf("ADDR_TYPE: '%s', ", ble_addr_type_str(r->ble.addr_type));
       }
       if (r->transport == ESP_HID_TRANSPORT_BT) {
-        cr = r;
         printf("COD: %s[", esp_hid_cod_major_str(r->bt.cod.major));
         esp_hid_cod_minor_print(r->bt.cod.minor, stdout);
         printf("] srv 0x%03x, ", r->bt.cod.service);
@@ -784,15 +881,282 @@ BTKeyboard::devices_scan( int seconds_wait_time)
       printf("\n");
       r = r->next;
     }
-    if (cr) {
-      //open the last result
-      esp_hidh_dev_open(cr->bda, cr->transport, cr->ble.addr_type);
+    //open the best result (ranked, a keyboard when one was found)
+    LastKeyboard best;
+    memcpy(best.bda, results->bda, sizeof(esp_bd_addr_t));
+    best.transport = results->transport;
+    best.addr_type = (results->transport == ESP_HID_TRANSPORT_BLE) ? results->ble.addr_type : BLE_ADDR_TYPE_PUBLIC;
+    open_keyboard(best, DEFAULT_OPEN_TIMEOUT_MS);
+  }
+}
+
+// Every device is opened through here, for its BLE address type to be known once it is open.
+// Called with open_lock taken.
+esp_hidh_dev_t *
+BTKeyboard::open_device(esp_bd_addr_t bda, esp_hid_transport_t transport, uint8_t addr_type)
+{
+  memcpy(opening.bda, bda, sizeof(esp_bd_addr_t));
+  opening.transport = transport;
+  opening.addr_type = addr_type;
+  open_pending      = true;
+
+  esp_hidh_dev_t * dev = esp_hidh_dev_open(bda, transport, addr_type);
+  if (dev == nullptr) open_pending = false;  // no OPEN event will come
+  return dev;
+}
+
+bool
+BTKeyboard::open_last_keyboard(uint32_t timeout_ms)
+{
+  return last_valid && open_keyboard(last, timeout_ms);
+}
+
+bool
+BTKeyboard::open_keyboard(const LastKeyboard & keyboard, uint32_t timeout_ms)
+{
+  ESP_LOGI(TAG, "Opening the keyboard " ESP_BD_ADDR_STR " (%s)", ESP_BD_ADDR_HEX(keyboard.bda),
+                (keyboard.transport == ESP_HID_TRANSPORT_BLE) ? "BLE" : "BT");
+
+  // app_main and the reconnect task both open keyboards: one at a time, for the OPEN event to
+  // be matched with the right one
+  xSemaphoreTake(open_lock, portMAX_DELAY);
+
+  xSemaphoreTake(open_semaphore, 0);  // given by an earlier OPEN
+  open_ok = false;
+
+  // A BLE open waits for the connection, and fails right away on a keyboard that is off
+  bool ok = open_device((uint8_t *) keyboard.bda, (esp_hid_transport_t) keyboard.transport, keyboard.addr_type) != nullptr;
+  ok      = ok && (xSemaphoreTake(open_semaphore, pdMS_TO_TICKS(timeout_ms)) == pdTRUE) && open_ok;
+
+  xSemaphoreGive(open_lock);
+  return ok;
+}
+
+bool
+BTKeyboard::is_connected() const
+{
+  for (const Device & device : devices) {
+    if (device.state == DeviceState::OPEN) return true;
+  }
+  return false;
+}
+
+// On the HID host event task, as all the writes of dev: a linear search of a few slots,
+// no lock.  nullptr: a device past MAX_DEVICES, its reports are ignored.
+BTKeyboard::Device *
+BTKeyboard::find_device(esp_hidh_dev_t * dev)
+{
+  for (Device & device : devices) {
+    if ((device.state == DeviceState::OPEN) && (device.dev == dev)) return &device;
+  }
+  return nullptr;
+}
+
+// The slot of a keyboard being opened: its own if it was connected before, else a free one,
+// else the one of a lost keyboard, that is not reconnected any more.
+BTKeyboard::Device *
+BTKeyboard::device_for(const LastKeyboard & address)
+{
+  Device * free_device = nullptr;
+  Device * lost_device = nullptr;
+
+  for (Device & device : devices) {
+    if (device.state == DeviceState::FREE) {
+      if (free_device == nullptr) free_device = &device;
+    }
+    else if ((memcmp(device.address.bda, address.bda, sizeof(esp_bd_addr_t)) == 0) &&
+             (device.address.transport == address.transport)) {
+      return &device;
+    }
+    else if ((device.state == DeviceState::LOST) && (lost_device == nullptr)) {
+      lost_device = &device;
+    }
+  }
+  return (free_device != nullptr) ? free_device : lost_device;
+}
+
+// OPEN event, on the HID host event task.  A classic keyboard may also have connected back
+// by itself: its BLE address type does not matter then.  Only the OPEN of the keyboard being
+// opened (or a failed one with no address) ends the wait of open_keyboard(): another keyboard
+// connecting back in the meantime does not.
+void
+BTKeyboard::opened(esp_hidh_dev_t * dev, esp_err_t status)
+{
+  const uint8_t * bda      = (dev != nullptr) ? esp_hidh_dev_bda_get(dev) : nullptr;
+  const bool      expected = open_pending &&
+                             ((bda == nullptr) || (memcmp(bda, opening.bda, sizeof(esp_bd_addr_t)) == 0));
+  const bool      incoming = !expected;
+
+  if (expected) {
+    open_pending = false;
+    open_ok      = (status == ESP_OK);
+  }
+
+  if ((status == ESP_OK) && (bda != nullptr)) {
+    LastKeyboard keyboard;
+    memcpy(keyboard.bda, bda, sizeof(esp_bd_addr_t));
+    keyboard.transport = esp_hidh_dev_transport_get(dev);
+    keyboard.addr_type = (memcmp(keyboard.bda, opening.bda, sizeof(esp_bd_addr_t)) == 0) ? opening.addr_type : (uint8_t) BLE_ADDR_TYPE_PUBLIC;
+
+    Device * device = device_for(keyboard);
+    if (device == nullptr) {
+      ESP_LOGW(TAG, "Already %u keyboards connected, " ESP_BD_ADDR_STR " ignored", MAX_DEVICES, ESP_BD_ADDR_HEX(keyboard.bda));
+    }
+    else {
+      if (device->state == DeviceState::LOST) {
+        const uint32_t latency_ms = (uint32_t) ((esp_timer_get_time() - device->closed_us) / 1000);
+
+        reconnect_stats.reconnects++;
+        if (incoming) reconnect_stats.incoming++;
+        reconnect_stats.last_latency_ms = latency_ms;
+        if (latency_ms > reconnect_stats.max_latency_ms) reconnect_stats.max_latency_ms = latency_ms;
+        ESP_LOGI(TAG, "Reconnected%s in %u ms (%u reconnections, %u attempts, longest %u ms)",
+                      incoming ? " by the keyboard" : "", latency_ms, reconnect_stats.reconnects,
+                      reconnect_stats.attempts, reconnect_stats.max_latency_ms);
+      }
+      device->dev         = dev;
+      device->address     = keyboard;
+      device->last_queued = KeyInfo();
+      device->connection++;                     // the key task starts it with no key held
+      load_report_maps(*device, dev);
+      device->state       = DeviceState::OPEN;  // last, find_device() looks at it first
+      ESP_LOGI(TAG, "Keyboard %u: " ESP_BD_ADDR_STR, device_index(*device), ESP_BD_ADDR_HEX(keyboard.bda));
+    }
+
+    // Only written when it changes, to spare the flash
+    if (!last_valid || (memcmp(&keyboard, &last, sizeof(LastKeyboard)) != 0)) {
+      last       = keyboard;
+      last_valid = true;
+      save_last_keyboard();
     }
-    //free the results
-    esp_hid_scan_results_free(results);
   }
+  if (expected) xSemaphoreGive(open_semaphore);
+  if (reconnect_task_handle != nullptr) xTaskNotify(reconnect_task_handle, NOTIFY_OPENED, eSetBits);
 }
 
+// CLOSE event, on the HID host event task.  The keys held down on that device are released
+// (an empty report is queued, so its typematic stops) and the reconnect task takes over.
+void
+BTKeyboard::closed(esp_hidh_dev_t * dev)
+{
+  Device * device = find_device(dev);
+  if (device == nullptr) return;
+
+  reconnect_stats.disconnects++;
+
+  // The empty report may be dropped on a full queue: the repeat is also stopped here, and by
+  // repeat_key() on a device that is not open
+  queue_report(*device, KeyInfo());
+  esp_timer_stop(device->repeat_timer);
+  device->closed_us = esp_timer_get_time();
+  device->state     = DeviceState::LOST;
+  device->dev       = nullptr;
+  xTaskNotify(reconnect_task_handle, NOTIFY_CLOSED, eSetBits);
+}
+
+void
+BTKeyboard::reconnect_task(void * arg)
+{
+  BTKeyboard * self = (BTKeyboard *) arg;
+
+  for (;;) {
+    uint32_t notified;
+    xTaskNotifyWait(0, UINT32_MAX, &notified, portMAX_DELAY);
+
+    if (notified & (NOTIFY_CLOSED | NOTIFY_LAST)) self->reconnect((notified & NOTIFY_LAST) != 0);
+  }
+}
+
+void
+BTKeyboard::reconnect_last_keyboard()
+{
+  if (!last_valid || (reconnect_task_handle == nullptr)) return;
+
+  lost_last = last;  // last changes if devices_scan() opened another keyboard
+  xTaskNotify(reconnect_task_handle, NOTIFY_LAST, eSetBits);
+}
+
+bool
+BTKeyboard::any_lost() const
+{
+  for (const Device & device : devices) {
+    if (device.state == DeviceState::LOST) return true;
+  }
+  return false;
+}
+
+// A slot of the keyboard, open or lost (then reconnected through its slot)
+bool
+BTKeyboard::has_device(const LastKeyboard & address) const
+{
+  for (const Device & device : devices) {
+    if ((device.state != DeviceState::FREE) &&
+        (memcmp(device.address.bda, address.bda, sizeof(esp_bd_addr_t)) == 0) &&
+        (device.address.transport == address.transport)) return true;
+  }
+  return false;
+}
+
+// Opens the lost keyboards until they are all connected again, with an exponential backoff
+// between the rounds.  An OPEN event (a keyboard connecting back by itself) ends the wait early.
+// With last_keyboard, lost_last is opened too until it has a slot.
+void
+BTKeyboard::reconnect(bool last_keyboard)
+{
+  uint32_t delay_ms = 0;  // none before the first round
+
+  for (;;) {
+    if (delay_ms != 0) {
+      uint32_t notified = 0;
+      xTaskNotifyWait(0, UINT32_MAX, &notified, pdMS_TO_TICKS(delay_ms));
+      if (notified & NOTIFY_LAST) last_keyboard = true;
+    }
+
+    last_keyboard = last_keyboard && !has_device(lost_last);
+    if (!last_keyboard && !any_lost()) break;
+
+    if (last_keyboard) {
+      reconnect_stats.attempts++;
+      open_keyboard(lost_last, DEFAULT_OPEN_TIMEOUT_MS);
+    }
+    for (const Device & device : devices) {
+      if (device.state != DeviceState::LOST) continue;
+
+      const LastKeyboard address = device.address;  // only written by OPEN, before the state
+      reconnect_stats.attempts++;
+      open_keyboard(address, DEFAULT_OPEN_TIMEOUT_MS);
+    }
+
+    delay_ms = (delay_ms == 0)                           ? RECONNECT_MIN_DELAY_MS :
+               (delay_ms < (RECONNECT_MAX_DELAY_MS / 2)) ? (delay_ms * 2) : RECONNECT_MAX_DELAY_MS;
+  }
+}
+
+bool
+BTKeyboard::load_last_keyboard()
+{
+  nvs_handle_t handle;
+  size_t       size = sizeof(LastKeyboard);
+
+  last_valid = false;
+  if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle) == ESP_OK) {
+    last_valid = (nvs_get_blob(handle, NVS_LAST_KEY, &last, &size) == ESP_OK) && (size == sizeof(LastKeyboard));
+    nvs_close(handle);
+  }
+  return last_valid;
+}
+
+void
+BTKeyboard::save_last_keyboard()
+{
+  nvs_handle_t handle;
+
+  if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle) == ESP_OK) {
+    nvs_set_blob(handle, NVS_LAST_KEY, &last, sizeof(LastKeyboard));
+    nvs_commit(handle);
+    nvs_close(handle);
+  }
+}
 
 void 
 BTKeyboard::hidh_callback(void * handler_args, esp_event_base_t base, int32_t id, void * event_data)
@@ -816,6 +1180,7 @@ BTKeyboard::hidh_callback(void * handler_args, esp_event_base_t base, int32_t id
       } else {
         ESP_LOGE(TAG, " OPEN failed!");
       }
+      bt_keyboard->opened(param->open.dev, param->open.status);
       break;
     }
     case ESP_HIDH_BATTERY_EVENT: {
@@ -833,7 +1198,14 @@ BTKeyboard::hidh_callback(void * handler_args, esp_event_base_t base, int32_t id
                     param->input.report_id, 
                     param->input.length);
       ESP_LOG_BUFFER_HEX_LEVEL(TAG, param->input.data, param->input.length, ESP_LOG_DEBUG);
-      bt_keyboard->push_key(param->input.data, param->input.length);
+      // Only the keyboard reports: combo receivers and macro pads also send mouse and
+      // consumer control (media keys) reports
+      if (param->input.usage != ESP_HID_USAGE_KEYBOARD) break;
+      Device * device = bt_keyboard->find_device(param->input.dev);
+      if (device != nullptr) {
+        bt_keyboard->push_key(*device, param->input.map_index, (uint8_t) param->input.report_id,
+                              param->input.data, param->input.length);
+      }
       break;
     }
     case ESP_HIDH_FEATURE_EVENT:  {
@@ -850,6 +1222,10 @@ BTKeyboard::hidh_callback(void * handler_args, esp_event_base_t base, int32_t id
     case ESP_HIDH_CLOSE_EVENT: {
       const uint8_t *bda = esp_hidh_dev_bda_get(param->close.dev);
       ESP_LOGV(TAG, ESP_BD_ADDR_STR " CLOSE: %s", ESP_BD_ADDR_HEX(bda), esp_hidh_dev_name_get(param->close.dev));
+      ESP_LOGV(TAG, "REPORTS: %u, DROPPED: %u, COALESCED: %u, HIGH WATER: %u/%u",
+                    bt_keyboard->queue_stats.reports, bt_keyboard->queue_stats.dropped,
+                    bt_keyboard->queue_stats.coalesced, bt_keyboard->queue_stats.high_water, bt_keyboard->queue_depth);
+      bt_keyboard->closed(param->close.dev);
       break;
     }
     default:
@@ -858,77 +1234,342 @@ BTKeyboard::hidh_callback(void * handler_args, esp_event_base_t base, int32_t id
   }
 }
 
-void 
-BTKeyboard::push_key(uint8_t * keys, uint8_t size)
-{
-  KeyInfo inf;
-  inf.modifier = (KeyModifier) keys[0];
-  
-  uint8_t max = (size > MAX_KEY_COUNT + 2) ? MAX_KEY_COUNT : size - 2;
-  inf.keys[0] = inf.keys[1] = inf.keys[2] = 0;
-  for (int i = 0; i < max; i++) {
-    inf.keys[i] = keys[i + 2];
-  }
-
-  xQueueSend(event_queue, &inf, 0);
-}
+// The layout of a boot report: modifiers, reserved byte, then an array of up to 6 usages
+const BTKeyboard::KeyboardReport BTKeyboard::BOOT_REPORT = { 0, 0, false, 0, 6, 0, 16 };
 
-char
-BTKeyboard::wait_for_ascii_char(bool forever)
+// On OPEN, before the device is found by find_device(): the layouts of its keyboard reports
+void
+BTKeyboard::load_report_maps(Device & device, esp_hidh_dev_t * dev)
 {
-  KeyInfo inf;
+  size_t                     map_count = 0;
+  esp_hid_raw_report_map_t * maps      = nullptr;
 
-  while (true) {
-    if (!wait_for_low_event(inf, (last_ch == 0) ? (forever ? portMAX_DELAY : 0) : repeat_period)) {
-      repeat_period = pdMS_TO_TICKS(120);
-      return last_ch;
-    }
+  device.keyboard_report_count = 0;
+  if (esp_hidh_dev_report_maps_get(dev, &map_count, &maps) != ESP_OK) return;
 
-    int k = -1;
-    for (int i = 0; i < MAX_KEY_COUNT; i++) {
-      if ((k < 0) && key_avail[i]) k = i;
-      key_avail[i] = inf.keys[i] == 0; 
-    }
+  for (size_t i = 0; i < map_count; i++) {
+    parse_report_map(device, (uint8_t) i, maps[i].data, maps[i].len);
+  }
+  for (uint8_t i = 0; i < device.keyboard_report_count; i++) {
+    const KeyboardReport & r = device.keyboard_reports[i];
+    ESP_LOGI(TAG, "Keyboard report %u/%u: %s of %u keys at bit %u, modifiers at bit %u", r.map_index, r.report_id,
+                  r.bitmap ? "bitmap" : "array", r.key_count, r.keys_bit, r.modifier_bit);
+  }
+}
 
-    if (k < 0) {
+// Finds the fields of the keyboard page (0x07) in the input reports of a HID report map.  Only
+// the items giving the size of the reports are decoded: Report ID, Size and Count, Usage Page,
+// Usage (Minimum), and Input.  PUSH / POP are not supported (keyboards don't use them).
+void
+BTKeyboard::parse_report_map(Device & device, uint8_t map_index, const uint8_t * map, uint16_t length)
+{
+  static const uint8_t  MAX_REPORT_IDS  = 8;
+  static const uint16_t USAGE_PAGE_KEYS = 0x07;
+
+  uint16_t usage_page   = 0;
+  uint8_t  report_size  = 0;
+  uint16_t report_count = 0;
+  uint8_t  report_id    = 0;
+  uint16_t bit          = 0;                        // of the next input field of report_id
+  uint32_t first_usage  = 0;
+  bool     has_usage    = false;
+
+  uint8_t  ids[MAX_REPORT_IDS];                     // the input size of each report ID seen
+  uint16_t bits[MAX_REPORT_IDS];
+  uint8_t  id_count     = 0;
+
+  uint16_t i = 0;
+  while (i < length) {
+    const uint8_t prefix = map[i++];
+
+    if (prefix == 0xFE) {                           // long item: size, tag, data
+      if (i >= length) break;
+      i += 2 + map[i];
       continue;
     }
 
-    char ch = inf.keys[k];
+    const uint8_t size  = ((prefix & 0x03) == 0x03) ? 4 : (prefix & 0x03);
+    uint32_t      value = 0;
+
+    if (i + size > length) break;
+    for (uint8_t b = 0; b < size; b++) value |= (uint32_t) map[i + b] << (8 * b);
+    i += size;
+
+    switch (prefix & 0xFC) {
+      case 0x04: usage_page   = (uint16_t) value; break;  // Usage Page
+      case 0x74: report_size  = (uint8_t)  value; break;  // Report Size
+      case 0x94: report_count = (uint16_t) value; break;  // Report Count
+      case 0x84: {                                          // Report ID: each has its own offsets
+        uint8_t j = 0;
+        while ((j < id_count) && (ids[j] != report_id)) j++;
+        if (j < MAX_REPORT_IDS) {
+          ids[j]  = report_id;
+          bits[j] = bit;
+          if (j == id_count) id_count++;
+        }
 
-    if (ch >= 4) {
-      if ((uint8_t) inf.modifier & CTRL_MASK) {
-        if (ch < (3 + 26)) {
-          repeat_period = pdMS_TO_TICKS(500);
-          return last_ch = (ch - 3);
+        report_id = (uint8_t) value;
+        bit       = 0;
+        for (j = 0; j < id_count; j++) {
+          if (ids[j] == report_id) bit = bits[j];
         }
+        break;
       }
-      else if (ch <= 0x52) {
-        //ESP_LOGI(TAG, "Scan code: %d", ch);
-        if (ch == KEY_CAPS_LOCK) caps_lock = !caps_lock;
-        if ((uint8_t) inf.modifier & SHIFT_MASK) {
-          if (caps_lock) {
-            repeat_period = pdMS_TO_TICKS(500);
-            return last_ch = shift_trans_dict[(ch - 4) << 1];
-          }
-          else {
-            repeat_period = pdMS_TO_TICKS(500);
-            return last_ch = shift_trans_dict[((ch - 4) << 1) + 1];
-          }
-        }
-        else {
-          if (caps_lock) {
-            repeat_period = pdMS_TO_TICKS(500);
-            return last_ch = shift_trans_dict[((ch - 4) << 1) + 1];
-          }
-          else {
-            repeat_period = pdMS_TO_TICKS(500);
-            return last_ch = shift_trans_dict[(ch - 4) << 1];
+      case 0x08:                                            // Usage
+      case 0x18:                                            // Usage Minimum
+        if (!has_usage || ((prefix & 0xFC) == 0x18)) first_usage = value;
+        has_usage = true;
+        break;
+      case 0x80: {                                          // Input
+        const bool constant = value & 0x01;
+        const bool variable = value & 0x02;
+        const bool keys     = ((first_usage >> 16) == USAGE_PAGE_KEYS) ||
+                              (((first_usage >> 16) == 0) && (usage_page == USAGE_PAGE_KEYS));
+
+        if (!constant && keys) {
+          const uint8_t    usage = (uint8_t) first_usage;
+          KeyboardReport * r     = keyboard_report(device, map_index, report_id, true);
+
+          if (r != nullptr) {
+            if (variable && (report_size == 1) && (usage == KEY_LEFT_CTRL) && (report_count == 8)) {
+              r->modifier_bit = bit;
+            }
+            else if (variable && (report_size == 1)) {
+              r->bitmap      = true;
+              r->first_usage = usage;
+              r->key_count   = report_count;
+              r->keys_bit    = bit;
+            }
+            else if (!variable && (report_size == 8)) {
+              r->bitmap    = false;
+              r->key_count = report_count;
+              r->keys_bit  = bit;
+            }
           }
         }
+        bit += (uint16_t) report_size * report_count;
+        has_usage = false;
+        break;
       }
+      case 0x90:                                            // Output
+      case 0xB0:                                            // Feature
+      case 0xA0:                                            // Collection
+      case 0xC0:                                            // End Collection
+        has_usage = false;
+        break;
+      default:
+        break;
     }
+  }
 
-    last_ch = 0; 
+  // A report with only the modifiers is of no use
+  uint8_t kept = 0;
+  for (uint8_t j = 0; j < device.keyboard_report_count; j++) {
+    if (device.keyboard_reports[j].keys_bit != NO_FIELD) device.keyboard_reports[kept++] = device.keyboard_reports[j];
   }
-}
\ No newline at end of file
+  device.keyboard_report_count = kept;
+}
+
+// The layout of a keyboard report of the device.  add: a new one is made when there is none
+// (nullptr when they are all taken).
+BTKeyboard::KeyboardReport *
+BTKeyboard::keyboard_report(Device & device, uint8_t map_index, uint8_t report_id, bool add)
+{
+  for (uint8_t i = 0; i < device.keyboard_report_count; i++) {
+    KeyboardReport & r = device.keyboard_reports[i];
+    if ((r.map_index == map_index) && (r.report_id == report_id)) return &r;
+  }
+  if (!add || (device.keyboard_report_count >= MAX_KEYBOARD_REPORTS)) return nullptr;
+
+  KeyboardReport & r = device.keyboard_reports[device.keyboard_report_count++];
+  r              = KeyboardReport();
+  r.map_index    = map_index;
+  r.report_id    = report_id;
+  r.modifier_bit = NO_FIELD;
+  r.keys_bit     = NO_FIELD;
+  return &r;
+}
+
+// 8 bits of a report from any bit offset, 0 past its end
+static uint8_t
+report_byte(const uint8_t * data, uint16_t length, uint16_t bit)
+{
+  const uint16_t i     = bit >> 3;
+  const uint8_t  shift = bit & 7;
+
+  if (i >= length) return 0;
+  uint16_t value = data[i];
+  if ((shift != 0) && (i + 1 < length)) value |= (uint16_t) data[i + 1] << 8;
+  return (uint8_t) (value >> shift);
+}
+
+// A keyboard input report (the report ID is not part of data), decoded with the layout its
+// report map gives, or as a boot report when it has none (boot protocol, or no report map).
+void 
+BTKeyboard::push_key(Device & device, uint8_t map_index, uint8_t report_id, const uint8_t * data, uint16_t length)
+{
+  const KeyboardReport * layout = keyboard_report(device, map_index, report_id);
+  if (layout == nullptr) layout = &BOOT_REPORT;
+
+  KeyInfo inf = {};
+  if (layout->modifier_bit != NO_FIELD) inf.modifier = (KeyModifier) report_byte(data, length, layout->modifier_bit);
+
+  for (uint16_t k = 0; k < layout->key_count; k++) {
+    if (layout->bitmap) {
+      const uint16_t b     = layout->keys_bit + k;
+      const uint16_t usage = layout->first_usage + k;
+      if ((usage >= FIRST_KEY_USAGE) && (usage < KEY_LEFT_CTRL) && ((b >> 3) < length) && (data[b >> 3] & (1 << (b & 7)))) {
+        hold(inf, (uint8_t) usage);
+      }
+    }
+    else {
+      const uint8_t usage = report_byte(data, length, layout->keys_bit + 8 * k);
+      if (usage == KEY_ERROR_ROLL_OVER) inf.roll_over = true;
+      else if ((usage >= FIRST_KEY_USAGE) && !is_held(inf, usage)) {
+        hold(inf, usage);
+        if (inf.key_count < MAX_ARRAY_KEYS) inf.keys[inf.key_count] = usage;
+        inf.key_count++;
+      }
+    }
+  }
+  if (inf.key_count > MAX_ARRAY_KEYS) {
+    inf.key_count = 0;
+    memset(inf.keys, 0, sizeof(inf.keys));  // compared by queue_report()
+  }
+  queue_report(device, inf);
+}
+
+void
+BTKeyboard::queue_report(Device & device, const KeyInfo & inf)
+{
+  Report report     = {};
+  report.info       = inf;
+  report.device     = device_index(device);
+  report.connection = device.connection;
+  report.time_us    = esp_timer_get_time();
+
+  queue_stats.reports++;
+
+  const UBaseType_t free_slots = uxQueueSpacesAvailable(event_queue);
+
+  if ((free_slots <= COALESCE_LEVEL) && (memcmp(&inf, &device.last_queued, sizeof(KeyInfo)) == 0)) {
+    queue_stats.coalesced++;
+  }
+  else if (xQueueSend(event_queue, &report, 0) != pdTRUE) {
+    queue_stats.dropped++;
+  }
+  else {
+    device.last_queued = inf;
+
+    const UBaseType_t used = queue_depth - free_slots + 1;  // at most, the key task may have taken some since
+    if (used > queue_stats.high_water) queue_stats.high_water = used;
+  }
+  notify_key_task(NOTIFY_INPUT);
+}
+void
+BTKeyboard::notify_key_task(uint32_t bits)
+{
+  if (key_task != nullptr) xTaskNotify(key_task, bits, eSetBits);
+}
+
+// In the esp_timer task, arg: the device
+void
+BTKeyboard::repeat_timer_callback(void * arg)
+{
+  bt_keyboard->notify_key_task(repeat_bit(bt_keyboard->device_index(*(Device *) arg)));
+}
+
+bool
+BTKeyboard::next_key(KeyPress & key)
+{
+  for (;;) {
+    if (decoding_usage < USAGE_COUNT) {
+      Device & device = devices[decoding.device];
+
+      while (decoding_usage < end_key(decoding.info)) {
+        const uint8_t usage = key_at(decoding.info, decoding_usage++);
+        if (!is_held(decoding.info, usage) || is_held(device.held, usage)) continue;
+
+        key.usage     = usage;
+        key.modifiers = (uint8_t) decoding.info.modifier;
+        key.device    = decoding.device;
+        key.time_us   = decoding.time_us;
+        return true;
+      }
+      device.held    = decoding.info;
+      decoding_usage = USAGE_COUNT;
+    }
+    if (!xQueueReceive(event_queue, &decoding, 0)) return false;
+    decoding_usage = decode_keys(decoding) ? first_key(decoding.info) : USAGE_COUNT;
+  }
+}
+
+
+bool
+BTKeyboard::repeat_key(uint32_t & notified, KeyPress & key, bool busy)
+{
+  while (notified & NOTIFY_REPEAT) {
+    const uint8_t i = (uint8_t) (__builtin_ctz(notified & NOTIFY_REPEAT) - 1);
+    Device &      device = devices[i];
+
+    notified &= ~repeat_bit(i);
+
+    // An active timer means a key was pressed after the notification was sent
+    if ((device.repeat.usage == 0) || esp_timer_is_active(device.repeat_timer)) continue;
+    if ((device.state != DeviceState::OPEN) || (device.held_connection != device.connection)) continue;
+
+    esp_timer_start_once(device.repeat_timer, repeat_rate_us);
+    if (busy) continue;
+
+    key         = device.repeat;
+    key.time_us = esp_timer_get_time();
+    return true;
+  }
+  return false;
+}
+
+// Compares the report to the keys held before on its device: next_key() returns the keys
+// newly pressed, and the last of them (but CAPS LOCK) is repeated after the typematic delay
+// of the device.  The repeat stops when its key is released.  Returns false when the report
+// is to be skipped: too many keys held, their state is unknown, the last one is kept.
+bool
+BTKeyboard::decode_keys(const Report & report)
+{
+  const KeyInfo & inf    = report.info;
+  Device &        device = devices[report.device];
+  KeyPress &      repeat = device.repeat;
+
+  // The slot was given to another keyboard, or its keyboard connected again: the keys held
+  // and the repeat of the last connection are forgotten
+  if (report.connection != device.held_connection) {
+    esp_timer_stop(device.repeat_timer);
+    device.held            = KeyInfo();
+    repeat.usage           = 0;
+    device.held_connection = report.connection;
+  }
+
+  if (inf.roll_over) return false;
+
+  bool new_repeat = false;
+
+  for (uint16_t i = first_key(inf); i < end_key(inf); i++) {
+    const uint8_t usage = key_at(inf, i);
+    if (!is_held(inf, usage) || is_held(device.held, usage) || (usage == KEY_CAPS_LOCK)) continue;
+
+    repeat.usage     = usage;
+    repeat.modifiers = (uint8_t) inf.modifier;
+    repeat.device    = report.device;
+    repeat.time_us   = report.time_us;
+    new_repeat       = true;
+  }
+
+  if (new_repeat) {
+    esp_timer_stop(device.repeat_timer);
+    esp_timer_start_once(device.repeat_timer, repeat_delay_us);
+  }
+  else if ((repeat.usage != 0) && !is_held(inf, repeat.usage)) {
+    esp_timer_stop(device.repeat_timer);
+    repeat.usage = 0;
+  }
+  return true;
+}
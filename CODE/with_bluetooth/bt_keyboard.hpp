@@ -25,6 +25,7 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include "esp_timer.h"
 #include "esp_err.h"
 #include "esp_log.h"
 #include "esp_system.h"
@@ -36,13 +37,16 @@
 #include "esp_hid_common.h"
 #include "esp_gap_bt_api.h"
 #include "esp_gap_ble_api.h"
+#include "nvs.h"
 
 class BTKeyboard
 {
   public:
     typedef void pid_handler(uint32_t code);
 
-    const uint8_t KEY_CAPS_LOCK = 0x39;
+    const uint8_t KEY_CAPS_LOCK       = 0x39;
+    const uint8_t KEY_ERROR_ROLL_OVER = 0x01;  // in all the key slots of a boot report
+    const uint8_t KEY_LEFT_CTRL       = 0xE0;  // the first of the 8 modifiers, given as bits
 
     enum class KeyModifier : uint8_t { 
       L_CTRL = 0x01, L_SHIFT = 0x02, L_ALT = 0x04, L_META = 0x08, 
@@ -53,15 +57,96 @@ class BTKeyboard
     const uint8_t   ALT_MASK = ((uint8_t) KeyModifier::L_ALT  ) | ((uint8_t) KeyModifier::R_ALT  );
     const uint8_t  META_MASK = ((uint8_t) KeyModifier::L_META ) | ((uint8_t) KeyModifier::R_META );
 
-    static const uint8_t MAX_KEY_COUNT = 3;
+    // Keyboards (or keypads...) connected at once, as many as the controller allows (bt_max_acl_conn)
+    static const uint8_t MAX_DEVICES = 3;
+
+    // Task notification bits given to the key task, see set_key_task()
+    static const uint32_t NOTIFY_INPUT  = 0x01;                            // HID input reports were queued
+    static const uint32_t NOTIFY_REPEAT = ((1 << MAX_DEVICES) - 1) << 1;  // the typematic timer of a device went off (one bit each)
+
+    // A HID keyboard input report, as the keys held down: one bit per usage, whatever the
+    // format of the report (boot report with an array of 6 usages, or bitmap report with
+    // every key held on NKRO keyboards), see push_key().  An array report also keeps its
+    // usages in the order of the array, for the keys pressed at once to be taken in that
+    // order; a bitmap report has none, its keys are taken by usage.
+    static const uint16_t USAGE_COUNT     = 256;
+    static const uint8_t  FIRST_KEY_USAGE = 4;     // 0 to 3: none, or an error code
+    static const uint8_t  MAX_ARRAY_KEYS  = 10;    // a longer array is taken by usage
     struct KeyInfo {
       KeyModifier modifier;
-      uint8_t     keys[MAX_KEY_COUNT];
+      bool        roll_over;                       // too many keys held: their state is unknown
+      uint8_t     usages[USAGE_COUNT / 8];
+      uint8_t     key_count;                       // of keys, 0: taken by usage
+      uint8_t     keys[MAX_ARRAY_KEYS];            // the usages of an array report, in order
+    };
+
+    // The reports of all the devices go through one queue, in the order they are received (the
+    // HID host event task handles the devices in turn), so by time.
+    struct Report {
+      KeyInfo info;
+      uint8_t device;      // index, 0 to MAX_DEVICES - 1
+      uint8_t connection;  // Device::connection when received
+      int64_t time_us;     // esp_timer_get_time() when received
+    };
+
+    // A key newly pressed: its usage, the modifiers of the report (KeyModifier bits), and the
+    // device it was pressed on
+    struct KeyPress {
+      uint8_t usage;
+      uint8_t modifiers;
+      uint8_t device;
+      int64_t time_us;  // of the report, or of the repeat
+    };
+
+    // Typematic defaults, see set_typematic()
+    static const uint32_t DEFAULT_REPEAT_DELAY_MS = 500;
+    static const uint32_t DEFAULT_REPEAT_RATE_MS  = 120;
+
+    // Depth of the queue of HID input reports, between the HID host event task and the key task
+    static const UBaseType_t DEFAULT_QUEUE_DEPTH = 64;
+
+    // Counters of the report queue.  Written by the HID host event task only.
+    struct QueueStats {
+      uint32_t    reports;     // received
+      uint32_t    dropped;     // lost, the queue being full
+      uint32_t    coalesced;   // not queued, being the same as the previous one with the queue nearly full
+      UBaseType_t high_water;  // most reports ever queued at once
+    };
+
+    // How long open_last_keyboard() waits for the keyboard, by default
+    static const uint32_t DEFAULT_OPEN_TIMEOUT_MS = 3000;
+
+    // Reconnection after a CLOSE (keyboard asleep, out of range...): the keyboard is opened
+    // again, waiting from RECONNECT_MIN_DELAY_MS, doubled after each failure, up to
+    // RECONNECT_MAX_DELAY_MS between two attempts.  A BLE open lasts until the keyboard
+    // advertises again, and a classic keyboard connects back by itself on its first key press.
+    static const uint32_t RECONNECT_MIN_DELAY_MS = 250;
+    static const uint32_t RECONNECT_MAX_DELAY_MS = 16000;
+
+    // Counters of the reconnections.  Written by the HID host event task and the reconnect task.
+    struct ReconnectStats {
+      uint32_t disconnects;      // CLOSE events
+      uint32_t reconnects;       // OPEN events after a CLOSE
+      uint32_t incoming;         // of which the keyboard connected back by itself
+      uint32_t attempts;         // opens tried by the reconnect task
+      uint32_t last_latency_ms;  // CLOSE to OPEN, of the last reconnection
+      uint32_t max_latency_ms;
     };
 
   private:
     static constexpr char const * TAG = "BTKeyboard";
 
+    // The last keyboard opened, saved in NVS (nvs_flash_init() must have been called) to be
+    // opened again at boot without a scan.  The bonding keys are kept in NVS by Bluedroid.
+    static constexpr char const * NVS_NAMESPACE = "btkbd";
+    static constexpr char const * NVS_LAST_KEY  = "last";
+
+    struct LastKeyboard {
+      esp_bd_addr_t bda;
+      uint8_t       transport;  // esp_hid_transport_t
+      uint8_t       addr_type;  // esp_ble_addr_type_t, for BLE
+    };
+
     static const esp_bt_mode_t HIDH_IDLE_MODE = (esp_bt_mode_t) 0x00;
     static const esp_bt_mode_t HIDH_BLE_MODE  = (esp_bt_mode_t) 0x01;
     static const esp_bt_mode_t HIDH_BT_MODE   = (esp_bt_mode_t) 0x02;
@@ -103,10 +188,25 @@ class BTKeyboard
       };
     };
 
+    // Scan results, see clear_scan_results()
+    static const uint8_t  SCAN_RESULT_CAPACITY = 16;
+    static const uint8_t  SCAN_INDEX_SIZE      = 32;    // power of 2
+    static const uint8_t  SCAN_INDEX_FREE      = 0xFF;
+    static const uint16_t SCAN_NAME_ARENA_SIZE = 512;
+
+    esp_hid_scan_result_t   scan_results[SCAN_RESULT_CAPACITY];
+    uint8_t                 scan_result_count;
+    uint8_t                 scan_index[SCAN_INDEX_SIZE];  // into scan_results, by scan_hash()
+    char                    scan_names[SCAN_NAME_ARENA_SIZE];
+    uint16_t                scan_names_used;
+
     esp_hid_scan_result_t * bt_scan_results;
     esp_hid_scan_result_t * ble_scan_results;
     size_t                  num_bt_scan_results;
     size_t                  num_ble_scan_results;
+    volatile bool           bt_scanning;
+    volatile bool           ble_scanning;
+    bool                    scan_stopping;         // a keyboard was found
 
     static void hidh_callback(void * handler_args, esp_event_base_t base, int32_t id, void * event_data);
 
@@ -123,13 +223,19 @@ class BTKeyboard
     static const char *       bt_gap_evt_names[];
     static const char *    ble_addr_type_names[];
 
-    static const char         shift_trans_dict[];
-
     void  handle_bt_device_result(esp_bt_gap_cb_param_t  * param);
     void handle_ble_device_result(esp_ble_gap_cb_param_t * scan_rst);
   
-    void esp_hid_scan_results_free(esp_hid_scan_result_t * results);
-    esp_hid_scan_result_t * find_scan_result(esp_bd_addr_t bda, esp_hid_scan_result_t * results);
+    void                    clear_scan_results();
+    esp_hid_scan_result_t * find_scan_result(const esp_bd_addr_t bda, esp_hid_transport_t transport);
+    esp_hid_scan_result_t *  new_scan_result(const esp_bd_addr_t bda, esp_hid_transport_t transport);
+    const char *                 intern_name(const uint8_t * name, uint8_t name_len);
+
+    static uint8_t scan_hash(const esp_bd_addr_t bda, esp_hid_transport_t transport);
+    void                    scan_found(const esp_hid_scan_result_t * r);
+    esp_hid_scan_result_t * rank_scan_results(esp_hid_scan_result_t * results);
+
+    static bool ranks_before(const esp_hid_scan_result_t * a, const esp_hid_scan_result_t * b);
 
     void  add_bt_scan_result(esp_bd_addr_t   bda, 
                              esp_bt_cod_t  * cod, 
@@ -153,37 +259,208 @@ class BTKeyboard
 
     inline void set_battery_level(uint8_t level) { battery_level = level; }
 
-    void push_key(uint8_t * keys, uint8_t size);
+    // Where the keys are in a keyboard input report, as declared by the report map of the
+    // device (bit offsets, from the first byte after the report ID).
+    static const uint16_t NO_FIELD = 0xFFFF;
+    struct KeyboardReport {
+      uint8_t  map_index;
+      uint8_t  report_id;
+      bool     bitmap;        // one bit per usage from first_usage (NKRO), else an array of usages
+      uint8_t  first_usage;
+      uint16_t key_count;     // usages in the array, or bits of the bitmap
+      uint16_t modifier_bit;  // NO_FIELD: none
+      uint16_t keys_bit;
+    };
+    static const KeyboardReport BOOT_REPORT;   // the layout of a boot report
+    static const uint8_t MAX_KEYBOARD_REPORTS = 4;
+
+    // A keyboard connected, or lost and being reconnected.  The HID host event task only writes
+    // the first part, the key task only the second one (but at setup), so each report is
+    // dispatched to its device without any lock.
+    enum class DeviceState : uint8_t { FREE, OPEN, LOST };
+
+    struct Device {
+      // HID host event task
+      volatile DeviceState state;
+      esp_hidh_dev_t *     dev;
+      LastKeyboard         address;      // to open it again
+      int64_t              closed_us;    // time of the CLOSE, while LOST
+      KeyInfo              last_queued;  // last report pushed to the queue
+      KeyboardReport       keyboard_reports[MAX_KEYBOARD_REPORTS];
+      uint8_t              keyboard_report_count;
+      volatile uint8_t     connection;       // counts the OPENs of the slot
+      // Key task
+      KeyInfo              held;             // the keys of the last report decoded
+      KeyPress             repeat;           // key repeated by the typematic timer, usage 0: none
+      esp_timer_handle_t   repeat_timer;
+      uint8_t              held_connection;  // connection held and repeat belong to
+    };
 
-    xQueueHandle  event_queue;
-    int8_t        battery_level;
-    bool          key_avail[MAX_KEY_COUNT];
-    char          last_ch;
-    TickType_t    repeat_period;
-    pid_handler * pairing_handler;
-    bool          caps_lock;
+    static inline uint32_t repeat_bit(uint8_t device) { return 0x02 << device; }
+
+    inline uint8_t device_index(const Device & device) const { return (uint8_t) (&device - devices); }
+
+    Device * find_device(esp_hidh_dev_t * dev);
+    Device * device_for(const LastKeyboard & address);
+
+    void   load_report_maps(Device & device, esp_hidh_dev_t * dev);
+    void   parse_report_map(Device & device, uint8_t map_index, const uint8_t * map, uint16_t length);
+    KeyboardReport * keyboard_report(Device & device, uint8_t map_index, uint8_t report_id, bool add = false);
+
+    void push_key(Device & device, uint8_t map_index, uint8_t report_id, const uint8_t * data, uint16_t length);
+    void queue_report(Device & device, const KeyInfo & inf);
+
+    esp_hidh_dev_t * open_device(esp_bd_addr_t bda, esp_hid_transport_t transport, uint8_t addr_type);
+    bool           open_keyboard(const LastKeyboard & keyboard, uint32_t timeout_ms);
+    void                 opened(esp_hidh_dev_t * dev, esp_err_t status);
+    bool   load_last_keyboard();
+    void   save_last_keyboard();
+    void               closed(esp_hidh_dev_t * dev);
+
+    // Reconnect task: sleeps until a CLOSE, then reconnects
+    static const uint32_t    RECONNECT_TASK_STACK_SIZE = 3072;
+    static const UBaseType_t RECONNECT_TASK_PRIORITY   = 4;   // below the translator task
+    static const uint32_t    NOTIFY_CLOSED             = 0x01;
+    static const uint32_t    NOTIFY_OPENED             = 0x02;
+    static const uint32_t    NOTIFY_LAST               = 0x04;  // from reconnect_last_keyboard()
+
+    static void reconnect_task(void * arg);
+    void reconnect(bool last_keyboard);
+    bool any_lost() const;
+    bool has_device(const LastKeyboard & address) const;
+
+    // With this many free slots or less, a report identical to the last one queued is dropped:
+    // a HID report gives the state of all the keys, so it changes nothing.
+    static const UBaseType_t COALESCE_LEVEL = 4;
+
+    static void repeat_timer_callback(void * arg);
+
+    bool decode_keys(const Report & report);
+    void notify_key_task(uint32_t bits);
+
+    static inline bool is_held(const KeyInfo & inf, uint8_t usage) { return inf.usages[usage >> 3] & (1 << (usage & 7)); }
+    static inline void    hold(KeyInfo & inf, uint8_t usage) { inf.usages[usage >> 3] |= (1 << (usage & 7)); }
+
+    // The usages of a report, in the order its keys are taken: index first_key() up to
+    // end_key(), excluded
+    static inline uint16_t first_key(const KeyInfo & inf) { return inf.key_count ? 0 : FIRST_KEY_USAGE; }
+    static inline uint16_t   end_key(const KeyInfo & inf) { return inf.key_count ? inf.key_count : USAGE_COUNT; }
+    static inline uint8_t   key_at(const KeyInfo & inf, uint16_t i) { return inf.key_count ? inf.keys[i] : (uint8_t) i; }
+
+    Device             devices[MAX_DEVICES];
+    xQueueHandle       event_queue;         // of Report
+    UBaseType_t        queue_depth;
+    QueueStats         queue_stats;
+    int8_t             battery_level;
+    // Key task side
+    Report             decoding;            // the report next_key() is going through
+    uint16_t           decoding_usage;      // index of its next usage (see key_at()), USAGE_COUNT: done
+    uint64_t           repeat_delay_us;
+    uint64_t           repeat_rate_us;
+    TaskHandle_t       key_task;
+    pid_handler      * pairing_handler;
+    // Device opening
+    LastKeyboard       opening;             // last one asked to esp_hidh_dev_open()
+    LastKeyboard       last;                // as saved in NVS
+    bool               last_valid;
+    LastKeyboard       lost_last;           // last, when reconnect_last_keyboard() was called
+    bool               open_ok;
+    xSemaphoreHandle   open_lock;           // mutex: one open at a time, for opening/open_pending
+    xSemaphoreHandle   open_semaphore;      // given on the OPEN event of opening
+    volatile bool      open_pending;        // open_device() called, no OPEN event since
+    TaskHandle_t       reconnect_task_handle;
+    ReconnectStats     reconnect_stats;
 
   public:
 
     BTKeyboard() : 
+      scan_result_count(0),
+      scan_names_used(0),
       bt_scan_results(nullptr),
       ble_scan_results(nullptr), 
       num_bt_scan_results(0), 
       num_ble_scan_results(0),
+      bt_scanning(false),
+      ble_scanning(false),
+      scan_stopping(false),
+      devices(),
+      queue_depth(0),
+      queue_stats(),
+      decoding(),
+      decoding_usage(USAGE_COUNT),
+      repeat_delay_us(DEFAULT_REPEAT_DELAY_MS * 1000),
+      repeat_rate_us(DEFAULT_REPEAT_RATE_MS * 1000),
+      key_task(nullptr),
       pairing_handler(nullptr),
-      caps_lock(false)
+      opening(),
+      last(),
+      last_valid(false),
+      lost_last(),
+      open_ok(false),
+      open_lock(nullptr),
+      open_semaphore(nullptr),
+      open_pending(false),
+      reconnect_task_handle(nullptr),
+      reconnect_stats()
     {
+      clear_scan_results();
     }
 
-    bool setup(pid_handler * handler = nullptr);
+    bool setup(pid_handler * handler = nullptr, UBaseType_t queue_depth = DEFAULT_QUEUE_DEPTH);
+
+    // Scans for HID devices (BLE and classic at once) for up to seconds_wait_time, stopping
+    // as soon as a keyboard is found, and opens the best one: keyboards first, then the
+    // strongest signal.  Waits for the open like open_last_keyboard().
     void devices_scan(int seconds_wait_time = 5);
 
+    // Opens the keyboard opened last time (saved in NVS on each successful open), which
+    // takes well under a second for a bonded keyboard that is on, against up to 5 seconds
+    // for devices_scan().  Returns false when there is none, or it did not open within
+    // timeout_ms: fall back on devices_scan() then.
+    bool open_last_keyboard(uint32_t timeout_ms = DEFAULT_OPEN_TIMEOUT_MS);
+
+    // Has the reconnect task open the keyboard of the last session until it connects, with
+    // the backoff of a keyboard lost: for one asleep when open_last_keyboard() failed.
+    void reconnect_last_keyboard();
+
     inline uint8_t get_battery_level() { return battery_level; }
+
+    inline const QueueStats & get_queue_stats() const { return queue_stats; }
+
+    inline const ReconnectStats & get_reconnect_stats() const { return reconnect_stats; }
+
+    // True while at least one device is connected
+    bool is_connected() const;
     
-    inline bool wait_for_low_event(KeyInfo & inf, TickType_t duration = portMAX_DELAY) {  
-      return xQueueReceive(event_queue, &inf, duration); 
+    inline bool wait_for_low_event(Report & report, TickType_t duration = portMAX_DELAY) {  
+      return xQueueReceive(event_queue, &report, duration); 
     }
 
-    char wait_for_ascii_char(bool forever = true);
-    inline char get_ascii_char() { return wait_for_ascii_char(false); }
+    // The key task is notified (NOTIFY_INPUT, NOTIFY_REPEAT) when there is something to read
+    // with the two methods below, so it can block on xTaskNotifyWait() in between.  To be set
+    // before devices_scan().
+    inline void set_key_task(TaskHandle_t task) { key_task = task; }
+
+    // Decodes the queued HID input reports (of all the devices, in the order received) up to
+    // the next key pressed, and returns it in key, or false once they are all decoded.  Each
+    // report is compared to the previous one of its device: all the keys it newly presses are
+    // returned, in the order of its array (of their usages for a bitmap report).  The keys
+    // are left to translate (KbdTranslator::put_hid(), CAPS LOCK included).  Never waits.
+    bool next_key(KeyPress & key);
+
+    // After a NOTIFY_REPEAT, returns in key the key still held down on one of the devices
+    // of the notified bits, clearing the bits looked at, or false once there are none left
+    // (key released, or pressed again since the notification).  busy: the keys given before
+    // are still waiting to be played, the repeat is skipped and tried again after the repeat
+    // period.  So the keys never repeat faster than they are played, and none are left
+    // queued when the key is released.  Each device has its own typematic.
+    bool repeat_key(uint32_t & notified, KeyPress & key, bool busy = false);
+
+    // Typematic delay (key held down before the first repeat) and rate (time between two
+    // repeats), for the keys pressed from now on.
+    inline void set_typematic(uint32_t delay_ms, uint32_t rate_ms)
+    {
+      repeat_delay_us = (uint64_t) delay_ms * 1000;
+      repeat_rate_us  = (uint64_t) rate_ms  * 1000;
+    }
 };